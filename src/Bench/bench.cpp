@@ -0,0 +1,201 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QtGlobal>
+
+namespace bench {
+namespace {
+struct UnitSuffix {
+  const char* suffix;
+  const char* unit;
+  Better better;
+};
+
+// Naming convention of the JSON files, e.g. cpu_record_us_per_draw.
+constexpr UnitSuffix kUnits[]{
+    {"_ns", "ns", Better::kLower},
+    {"_us", "us", Better::kLower},
+    {"_ms", "ms", Better::kLower},
+    {"fps", "frames/s", Better::kHigher},
+    {"_gbps", "GB/s", Better::kHigher},
+    {"_mbps", "MB/s", Better::kHigher},
+    {"_gflops", "GFLOP/s", Better::kHigher},
+    {"_gops", "Gop/s", Better::kHigher},
+    {"_ratio", "", Better::kHigher},
+};
+
+// Metrics that are better when higher whatever their unit says, e.g. the
+// time async compute overlaps rendering.
+constexpr const char* kHigherIsBetter[]{"overlap"};
+
+Better Direction(const QString& key, const UnitSuffix& unit) {
+  for (const char* prefix : kHigherIsBetter) {
+    if (key.startsWith(QLatin1String(prefix))) {
+      return Better::kHigher;
+    }
+  }
+  return unit.better;
+}
+
+const UnitSuffix* FindUnit(const QString& key) {
+  for (const UnitSuffix& unit : kUnits) {
+    const QString suffix = QString::fromLatin1(unit.suffix);
+    if (key.endsWith(suffix) || key.contains(suffix + QLatin1Char('_'))) {
+      return &unit;
+    }
+  }
+  return nullptr;
+}
+
+QString ElementName(const QJsonValue& element, int position) {
+  const QJsonObject object = element.toObject();
+  for (const char* key : {"name", "draw_path", "index", "bytes"}) {
+    const QJsonValue value = object.value(QLatin1String(key));
+    if (value.isString()) {
+      return value.toString();
+    }
+    if (value.isDouble()) {
+      return QString::number(qint64(value.toDouble()));
+    }
+  }
+  return QString::number(position);
+}
+}  // namespace
+
+void AddOptions(QCommandLineParser* parser) {
+  parser->addOption(
+      {"warmup", "Repetitions to run and discard before measuring.", "n",
+       "0"});
+  parser->addOption(
+      {"repetitions", "Measured repetitions, summarized in the JSON file.",
+       "n", "1"});
+}
+
+Options ParseOptions(const QCommandLineParser& parser) {
+  Options options;
+  options.warmup = qMax(0, parser.value("warmup").toInt());
+  options.repetitions = qMax(1, parser.value("repetitions").toInt());
+  return options;
+}
+
+Summary Summarize(std::vector<double> samples) {
+  Summary summary;
+  summary.count = int(samples.size());
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t half = samples.size() / 2;
+  summary.median = samples.size() % 2
+                       ? samples[half]
+                       : (samples[half - 1] + samples[half]) / 2;
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                 double(samples.size());
+  double squares{};
+  for (double sample : samples) {
+    squares += (sample - summary.mean) * (sample - summary.mean);
+  }
+  summary.stddev =
+      samples.size() > 1 ? std::sqrt(squares / double(samples.size() - 1)) : 0;
+  summary.min = samples.front();
+  summary.max = samples.back();
+  return summary;
+}
+
+bool Suite::Run(const Options& options,
+                const std::function<bool()>& repetition) {
+  warmup_ = options.warmup;
+  repetitions_ = options.repetitions;
+  for (int i = 0; i < options.warmup + options.repetitions; ++i) {
+    warming_up_ = i < options.warmup;
+    const bool ok = repetition();
+    warming_up_ = false;
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Suite::Add(const QString& metric,
+                double value,
+                const char* unit,
+                Better better) {
+  if (warming_up_ || value < 0 || !std::isfinite(value)) {
+    return;
+  }
+  Metric& entry = metrics_[metric];
+  entry.unit = unit;
+  entry.better = better;
+  entry.samples.push_back(value);
+}
+
+void Suite::AddJson(const QString& prefix, const QJsonObject& json) {
+  for (auto it = json.begin(); it != json.end(); ++it) {
+    AddValue(prefix.isEmpty() ? it.key() : prefix + '/' + it.key(),
+             it.value());
+  }
+}
+
+void Suite::AddValue(const QString& name, const QJsonValue& value) {
+  if (value.isObject()) {
+    AddJson(name, value.toObject());
+  } else if (value.isArray()) {
+    const QJsonArray array = value.toArray();
+    for (int i = 0; i < array.size(); ++i) {
+      AddValue(name + '/' + ElementName(array.at(i), i), array.at(i));
+    }
+  } else if (value.isDouble()) {
+    const QString key = name.mid(name.lastIndexOf('/') + 1);
+    if (const UnitSuffix* unit = FindUnit(key)) {
+      Add(name, value.toDouble(), unit->unit, Direction(key, *unit));
+    }
+  }
+}
+
+void Suite::Log() const {
+  if (metrics_.empty()) {
+    return;
+  }
+  qInfo("%s: %d repetitions after %d warmup", qPrintable(name_),
+        repetitions_, warmup_);
+  for (const auto& [name, metric] : metrics_) {
+    const Summary summary = Summarize(metric.samples);
+    qInfo("  %-56s %12.3f %-8s +-%5.1f%%", qPrintable(name), summary.median,
+          metric.unit,
+          summary.mean > 0 ? 100 * summary.stddev / summary.mean : 0.0);
+  }
+}
+
+QJsonObject Suite::ToJson() const {
+  QJsonArray benchmarks;
+  for (const auto& [name, metric] : metrics_) {
+    const Summary summary = Summarize(metric.samples);
+    QJsonArray samples;
+    for (double sample : metric.samples) {
+      samples.append(sample);
+    }
+    benchmarks.append(QJsonObject{
+        {"name", name},
+        {"unit", QLatin1String(metric.unit)},
+        {"better",
+         metric.better == Better::kLower ? "lower" : "higher"},
+        {"count", summary.count},
+        {"median", summary.median},
+        {"mean", summary.mean},
+        {"stddev", summary.stddev},
+        {"min", summary.min},
+        {"max", summary.max},
+        {"samples", samples}});
+  }
+  return {{"suite", name_},
+          {"warmup", warmup_},
+          {"repetitions", repetitions_},
+          {"benchmarks", benchmarks}};
+}
+
+}  // namespace bench
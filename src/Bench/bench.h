@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+// Benchmark harness shared by the headless modes of all applications.
+//
+// An application measures one repetition at a time and adds its numbers to
+// a Suite; Run() repeats that after a few warmup repetitions whose numbers
+// are thrown away. The suite keeps every sample and summarizes each metric
+// as median, mean, standard deviation, min and max, which is what the
+// results file holds and what BenchCompare checks against a baseline.
+namespace bench {
+
+enum class Better : quint8 { kLower, kHigher };
+
+struct Options {
+  int warmup{0};
+  int repetitions{1};
+};
+
+// --warmup and --repetitions, so every application spells them the same.
+void AddOptions(QCommandLineParser* parser);
+Options ParseOptions(const QCommandLineParser& parser);
+
+struct Summary {
+  int count{};
+  double median{-1};
+  double mean{-1};
+  double stddev{-1};
+  double min{-1};
+  double max{-1};
+};
+
+Summary Summarize(std::vector<double> samples);
+
+class Suite {
+ public:
+  explicit Suite(const QString& name) : name_(name) {}
+
+  // Calls `repetition` options.warmup + options.repetitions times; what it
+  // adds during warmup is discarded. Stops at the first repetition that
+  // returns false and returns false too.
+  bool Run(const Options& options, const std::function<bool()>& repetition);
+
+  // One sample of `metric`. Negative values mean "not measured", as in the
+  // JSON files, and are skipped.
+  void Add(const QString& metric,
+           double value,
+           const char* unit,
+           Better better = Better::kLower);
+  // Adds every number of `json` whose key names a unit (_us, _gbps, fps...)
+  // under `prefix`/key. Nested objects extend the prefix by their key, array
+  // elements by their "name", "draw_path", "index" or "bytes" member. The
+  // unit decides whether lower or higher is better, except for keys known
+  // to mean the opposite (overlap_us).
+  void AddJson(const QString& prefix, const QJsonObject& json);
+
+  // Logs one line per metric.
+  void Log() const;
+  // Summaries in the format BenchCompare reads.
+  QJsonObject ToJson() const;
+
+ private:
+  struct Metric {
+    const char* unit{};
+    Better better{Better::kLower};
+    std::vector<double> samples;
+  };
+
+  void AddValue(const QString& name, const QJsonValue& value);
+
+  QString name_;
+  std::map<QString, Metric> metrics_;  // sorted, so files diff well
+  int warmup_{};
+  int repetitions_{};
+  bool warming_up_{false};
+};
+
+}  // namespace bench
@@ -0,0 +1,275 @@
+// Merges the JSON files written by the headless benchmarks and compares them
+// against a baseline:
+//   BenchCompare --baseline baseline.json --thresholds thresholds.json \
+//       --output results.json VkTriangleBench.json GlTriangleBench.json ...
+// Exits with 1 if any median regressed by more than its threshold, or if
+// results are missing: an unreadable file, a baseline metric that was not
+// measured or is now -1. --allow-missing only warns about the latter.
+
+#include <cstdlib>
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSysInfo>
+
+namespace {
+struct Threshold {
+  QRegularExpression pattern;
+  double percent{};
+};
+
+bool ReadJson(const QString& path, QJsonObject* json) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning("Failed to read %s", qPrintable(path));
+    return false;
+  }
+  QJsonParseError error{};
+  const QJsonDocument document =
+      QJsonDocument::fromJson(file.readAll(), &error);
+  if (!document.isObject()) {
+    qWarning("%s: %s", qPrintable(path), qPrintable(error.errorString()));
+    return false;
+  }
+  *json = document.object();
+  return true;
+}
+
+bool WriteJson(const QString& path, const QJsonObject& json) {
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Failed to write %s", qPrintable(path));
+    return false;
+  }
+  file.write(QJsonDocument(json).toJson());
+  return true;
+}
+
+// Only '*' is special, it matches anything including '/'.
+QRegularExpression Wildcard(const QString& pattern) {
+  QString regex = QRegularExpression::escape(pattern);
+  regex.replace(QLatin1String("\\*"), QLatin1String(".*"));
+  return QRegularExpression('^' + regex + '$');
+}
+
+// {"default_percent": 10, "overrides": [{"pattern": "...", "percent": 25}]},
+// the last matching override wins.
+double ThresholdFor(const QString& name,
+                    double default_percent,
+                    const QList<Threshold>& overrides) {
+  double percent = default_percent;
+  for (const Threshold& threshold : overrides) {
+    if (threshold.pattern.match(name).hasMatch()) {
+      percent = threshold.percent;
+    }
+  }
+  return percent;
+}
+
+// "<file name>/<metric>": the same suite runs in several configurations,
+// one file each. Counts the files that could not be read in `*unreadable`.
+QJsonObject Merge(const QStringList& paths, int* unreadable) {
+  QJsonObject benchmarks;
+  for (const QString& path : paths) {
+    QJsonObject json;
+    if (!ReadJson(path, &json)) {
+      ++*unreadable;
+      continue;
+    }
+    const QString file = QFileInfo(path).completeBaseName();
+    const QJsonArray entries =
+        json.value("bench").toObject().value("benchmarks").toArray();
+    if (entries.isEmpty()) {
+      qWarning("%s: no benchmarks, was it run with --json?", qPrintable(path));
+    }
+    for (const QJsonValue& entry : entries) {
+      QJsonObject benchmark = entry.toObject();
+      const QString name = file + '/' + benchmark.take("name").toString();
+      benchmark.remove("samples");
+      benchmarks[name] = benchmark;
+    }
+  }
+  return benchmarks;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Merges benchmark results and checks them against a baseline.");
+  parser.addHelpOption();
+  const QCommandLineOption baseline_option(
+      "baseline", "Baseline to compare with (or to write).", "file");
+  const QCommandLineOption thresholds_option(
+      "thresholds", "Per-benchmark regression thresholds.", "file");
+  const QCommandLineOption threshold_option(
+      "threshold",
+      "Default regression threshold in percent of the baseline median.",
+      "percent");
+  const QCommandLineOption output_option(
+      "output", "Write the merged results to <file>.", "file");
+  const QCommandLineOption update_option(
+      "update-baseline", "Replace the baseline with these results.");
+  const QCommandLineOption allow_missing_baseline_option(
+      "allow-missing-baseline",
+      "Succeed without comparing when the --baseline file does not exist.");
+  const QCommandLineOption allow_missing_option(
+      "allow-missing",
+      "Only warn about unreadable results and about baseline metrics that "
+      "were not measured or are now -1.");
+  parser.addOptions({baseline_option, thresholds_option, threshold_option,
+                     output_option, update_option,
+                     allow_missing_baseline_option, allow_missing_option});
+  parser.addPositionalArgument("results", "JSON files of the benchmarks.",
+                               "results...");
+  parser.process(app);
+
+  // A benchmark that stopped producing a metric must not pass as unchanged.
+  const bool allow_missing = parser.isSet(allow_missing_option);
+  int unreadable{};
+  const QJsonObject benchmarks =
+      Merge(parser.positionalArguments(), &unreadable);
+  if (benchmarks.isEmpty()) {
+    qCritical("No benchmark results");
+    return EXIT_FAILURE;
+  }
+  if (unreadable && !allow_missing) {
+    qCritical("%d result files could not be read", unreadable);
+    return EXIT_FAILURE;
+  }
+  const QJsonObject results{
+      {"host", QSysInfo::machineHostName()},
+      {"cpu", QSysInfo::currentCpuArchitecture()},
+      {"kernel", QSysInfo::kernelVersion()},
+      {"date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+      {"benchmarks", benchmarks}};
+  if (parser.isSet(output_option) &&
+      !WriteJson(parser.value(output_option), results)) {
+    return EXIT_FAILURE;
+  }
+
+  const QString baseline_path = parser.value(baseline_option);
+  if (parser.isSet(update_option)) {
+    if (baseline_path.isEmpty() || !WriteJson(baseline_path, results)) {
+      qCritical("--update-baseline needs a writable --baseline");
+      return EXIT_FAILURE;
+    }
+    qInfo("Baseline written to %s (%d benchmarks)", qPrintable(baseline_path),
+          int(benchmarks.size()));
+    return EXIT_SUCCESS;
+  }
+  if (baseline_path.isEmpty()) {
+    qInfo("No --baseline given, nothing to compare with");
+    return EXIT_SUCCESS;
+  }
+  // Passing without having compared anything would hide every regression.
+  if (!QFileInfo::exists(baseline_path)) {
+    if (parser.isSet(allow_missing_baseline_option)) {
+      qWarning("No baseline %s, nothing compared", qPrintable(baseline_path));
+      return EXIT_SUCCESS;
+    }
+    qCritical("No baseline %s, create one with --update-baseline (the "
+              "bench_baseline target)",
+              qPrintable(baseline_path));
+    return EXIT_FAILURE;
+  }
+
+  QJsonObject baseline;
+  if (!ReadJson(baseline_path, &baseline)) {
+    return EXIT_FAILURE;
+  }
+  const QString baseline_host = baseline.value("host").toString();
+  if (baseline_host != results["host"].toString()) {
+    qWarning("Baseline was recorded on %s, numbers may not be comparable",
+             qPrintable(baseline_host));
+  }
+
+  double default_percent{10};
+  QList<Threshold> overrides;
+  if (parser.isSet(thresholds_option)) {
+    QJsonObject thresholds;
+    if (!ReadJson(parser.value(thresholds_option), &thresholds)) {
+      return EXIT_FAILURE;
+    }
+    default_percent =
+        thresholds.value("default_percent").toDouble(default_percent);
+    const QJsonArray entries = thresholds.value("overrides").toArray();
+    for (const QJsonValue& value : entries) {
+      const QJsonObject entry = value.toObject();
+      overrides.append(Threshold{Wildcard(entry["pattern"].toString()),
+                                 entry["percent"].toDouble(default_percent)});
+    }
+  }
+  if (parser.isSet(threshold_option)) {
+    default_percent = parser.value(threshold_option).toDouble();
+  }
+
+  const QJsonObject reference = baseline.value("benchmarks").toObject();
+  int regressions{};
+  int improvements{};
+  int compared{};
+  int missing{};
+  qInfo("%-64s %12s %12s %8s %6s", "benchmark", "baseline", "current",
+        "change", "limit");
+  for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+    const QJsonObject current = it.value().toObject();
+    const QJsonObject base = reference[it.key()].toObject();
+    const double now = current["median"].toDouble(-1);
+    const double then = base["median"].toDouble(-1);
+    if (then > 0 && now < 0) {
+      qInfo("%-64s %12.3f %12s %8s %6s  NOT MEASURED", qPrintable(it.key()),
+            then, "-1", "", "");
+      ++missing;
+      continue;
+    }
+    if (then <= 0 || now < 0) {
+      qInfo("%-64s %12s %12.3f %8s %6s", qPrintable(it.key()), "new", now, "",
+            "");
+      continue;
+    }
+    ++compared;
+    const double limit = ThresholdFor(it.key(), default_percent, overrides);
+    // Positive is worse, whichever direction is better.
+    double change = 100 * (now - then) / then;
+    if (current["better"].toString() == QLatin1String("higher")) {
+      change = -change;
+    }
+    const char* verdict = "";
+    if (change > limit) {
+      verdict = "  REGRESSED";
+      ++regressions;
+    } else if (change < -limit) {
+      verdict = "  improved";
+      ++improvements;
+    }
+    qInfo("%-64s %12.3f %12.3f %+7.1f%% %5.0f%%%s", qPrintable(it.key()), then,
+          now, change, limit, verdict);
+  }
+  for (auto it = reference.begin(); it != reference.end(); ++it) {
+    if (!benchmarks.contains(it.key())) {
+      qWarning("%s: in the baseline but not measured", qPrintable(it.key()));
+      ++missing;
+    }
+  }
+
+  qInfo("%d compared, %d regressed, %d improved, %d missing (positive change "
+        "is worse)",
+        compared, regressions, improvements, missing);
+  if (missing && !allow_missing) {
+    qCritical("%d baseline metrics were not measured, pass --allow-missing "
+              "if they were dropped on purpose",
+              missing);
+    return EXIT_FAILURE;
+  }
+  return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
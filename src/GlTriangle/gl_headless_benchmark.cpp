@@ -0,0 +1,219 @@
+#include "gl_headless_benchmark.h"
+
+#include <memory>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFunctions>
+#if QT_VERSION_MAJOR==5
+#include <QtGui/QOpenGLFramebufferObject>
+#else
+#include <QtOpenGL/QOpenGLFramebufferObject>
+#endif
+
+#include "gl_triangle_renderer.h"
+#include "tracing.h"
+
+namespace {
+// Animation speed of the window at 60 Hz.
+constexpr float kDegreesPerFrame{100.0f / 60};
+
+QByteArray GlString(QOpenGLFunctions* f, GLenum name) {
+  return reinterpret_cast<const char*>(f->glGetString(name));
+}
+
+// One path with its own context, framebuffer and renderer.
+struct PathTarget {
+  ~PathTarget() {
+    if (context.makeCurrent(&surface)) {
+      legacy.Release();
+      modern.Release();
+      fbo.reset();
+      context.doneCurrent();
+    }
+  }
+
+  GlPath path{};
+  QOffscreenSurface surface;
+  QOpenGLContext context;
+  std::unique_ptr<QOpenGLFramebufferObject> fbo;
+  GlTriangleRenderer legacy;
+  GlModernRenderer modern;
+  QByteArray renderer_name;
+  QByteArray version;
+  int frame{};
+};
+
+// Null, after logging why, when `path` cannot be used.
+std::unique_ptr<PathTarget> CreateTarget(GlPath path,
+                                         const QSize& size,
+                                         const GlMeshScene* scene) {
+  auto target = std::make_unique<PathTarget>();
+  target->path = path;
+  target->surface.setFormat(path == GlPath::kModern
+                                ? GlModernRenderer::Format()
+                                : QSurfaceFormat::defaultFormat());
+  target->surface.create();
+  target->context.setFormat(target->surface.format());
+  if (!target->context.create() ||
+      !target->context.makeCurrent(&target->surface)) {
+    qWarning("Failed to create an OpenGL context for the %s path",
+             GlPathName(path));
+    return nullptr;
+  }
+  if (path == GlPath::kModern &&
+      !GlModernRenderer::IsSupported(target->context)) {
+    qWarning("No OpenGL 4.5 context for the modern path");
+    return nullptr;
+  }
+  QOpenGLFunctions* f = target->context.functions();
+  target->renderer_name = GlString(f, GL_RENDERER);
+  target->version = GlString(f, GL_VERSION);
+
+  target->fbo = std::make_unique<QOpenGLFramebufferObject>(size);
+  if (!target->fbo->isValid() || !target->fbo->bind()) {
+    qWarning("Failed to create a %dx%d framebuffer object", size.width(),
+             size.height());
+    return nullptr;
+  }
+  if (path == GlPath::kModern) {
+    if (!target->modern.Init(scene)) {
+      return nullptr;
+    }
+  } else {
+    target->legacy.Init(scene);
+  }
+  return target;
+}
+
+// One run of `frames` frames after `warmup_frames` on `target`.
+QJsonObject Measure(PathTarget* target,
+                    int warmup_frames,
+                    int frames,
+                    const QSize& size) {
+  target->context.makeCurrent(&target->surface);
+  target->fbo->bind();
+  QOpenGLFunctions* f = target->context.functions();
+  QElapsedTimer timer;
+  timer.start();
+  qint64 wall_start = timer.nsecsElapsed();
+  qint64 cpu_ns{};
+  for (int i = 0; i < warmup_frames + frames; ++i) {
+    if (i == warmup_frames) {
+      f->glFinish();
+      wall_start = timer.nsecsElapsed();
+      cpu_ns = 0;
+      target->modern.TakeFenceWaitNs();
+    }
+    TRACE_SCOPE("gl", "HeadlessFrame");
+    const qint64 start = timer.nsecsElapsed();
+    const float angle = kDegreesPerFrame * float(target->frame++);
+    if (target->path == GlPath::kModern) {
+      target->modern.Render(size, angle);
+    } else {
+      target->legacy.Render(size, angle);
+    }
+    // What a swap would do; keeps the driver from queueing without bound.
+    f->glFlush();
+    cpu_ns += timer.nsecsElapsed() - start;
+  }
+  f->glFinish();
+  const qint64 fence_wait_ns = target->modern.TakeFenceWaitNs();
+
+  const double seconds = (timer.nsecsElapsed() - wall_start) / 1e9;
+  const double fps = seconds > 0 ? frames / seconds : 0;
+  const double cpu_us = cpu_ns / 1e3 / qMax(frames, 1);
+  // Part of cpu_frame_us, for information only: the legacy path is held
+  // back inside the driver where that cannot be told apart, so the paths
+  // are compared on their whole frame time.
+  const double fence_wait_us = target->path == GlPath::kModern
+                                   ? fence_wait_ns / 1e3 / qMax(frames, 1)
+                                   : -1;
+  qInfo("    frames/s       = %.1f", fps);
+  qInfo("    cpu frame us   = %.2f", cpu_us);
+  qInfo("    fence wait us  = %.2f", fence_wait_us);
+  return {{"path", GlPathName(target->path)},
+          {"renderer", QString::fromUtf8(target->renderer_name)},
+          {"version", QString::fromUtf8(target->version)},
+          {"frames", frames},
+          {"fps", fps},
+          {"cpu_frame_us", cpu_us},
+          {"fence_wait_us", fence_wait_us}};
+}
+}  // namespace
+
+int GlHeadlessBenchmark::Run() {
+  const GlMeshScene scene(options_.meshes);
+  std::vector<std::unique_ptr<PathTarget>> targets;
+  for (GlPath path : options_.paths) {
+    std::unique_ptr<PathTarget> target =
+        CreateTarget(path, options_.size, &scene);
+    if (target) {
+      qInfo("GlTriangle headless, %s path on %s, %s", GlPathName(path),
+            target->renderer_name.constData(), target->version.constData());
+      targets.push_back(std::move(target));
+    } else if (path == GlPath::kLegacy) {
+      qCritical("Failed to create an OpenGL context, is there a display?");
+      return EXIT_FAILURE;
+    }
+  }
+  if (targets.empty()) {
+    return EXIT_FAILURE;
+  }
+  qInfo("  frames           = %d (%dx%d)", options_.frames,
+        options_.size.width(), options_.size.height());
+  qInfo("  meshes           = %d", scene.mesh_count());
+
+  bench::Suite suite("GlTriangle.headless");
+  QJsonArray runs;
+  double speedup{-1};
+  suite.Run(options_.bench, [&] {
+    runs = QJsonArray();
+    double legacy_us{-1};
+    double modern_us{-1};
+    for (const std::unique_ptr<PathTarget>& target : targets) {
+      qInfo("  %s", GlPathName(target->path));
+      const QJsonObject run = Measure(target.get(), options_.warmup_frames,
+                                      options_.frames, options_.size);
+      suite.AddJson(GlPathName(target->path), run);
+      runs.append(run);
+      const double cpu_us = run.value("cpu_frame_us").toDouble();
+      if (target->path == GlPath::kModern) {
+        modern_us = cpu_us;
+      } else {
+        legacy_us = cpu_us;
+      }
+    }
+    // How many times less CPU a frame takes on the modern path.
+    if (legacy_us > 0 && modern_us > 0) {
+      speedup = legacy_us / modern_us;
+      qInfo("  cpu speedup      = %.2fx", speedup);
+      suite.AddJson({}, QJsonObject{{"cpu_speedup_ratio", speedup}});
+    }
+    return true;
+  });
+  suite.Log();
+
+  if (options_.json_path.isEmpty()) {
+    return EXIT_SUCCESS;
+  }
+  const QJsonObject json{{"benchmark", "GlTriangle.headless"},
+                         {"width", options_.size.width()},
+                         {"height", options_.size.height()},
+                         {"meshes", scene.mesh_count()},
+                         {"cpu_speedup_ratio", speedup},
+                         {"runs", runs},
+                         {"bench", suite.ToJson()}};
+  QFile file(options_.json_path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Failed to write %s", qPrintable(options_.json_path));
+    return EXIT_FAILURE;
+  }
+  file.write(QJsonDocument(json).toJson());
+  return EXIT_SUCCESS;
+}
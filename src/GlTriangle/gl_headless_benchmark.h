@@ -0,0 +1,44 @@
+#ifndef GL_HEADLESS_BENCHMARK_H
+#define GL_HEADLESS_BENCHMARK_H
+
+#include <vector>
+
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+#include "bench.h"
+#include "gl_modern_renderer.h"
+
+// Renders the scene into a framebuffer object of an offscreen surface as
+// fast as the driver allows. Nothing is presented, so the numbers are not
+// capped by the display; on a machine without a GPU run it on Mesa's
+// llvmpipe, e.g. LIBGL_ALWAYS_SOFTWARE=1 xvfb-run GlTriangle ...
+//
+// Each path gets its own context: the legacy one with the default format,
+// the modern one with a 4.5 core profile. Every repetition measures all of
+// them back to back, so their ratio is a sample of its own.
+class GlHeadlessBenchmark {
+ public:
+  struct Options {
+    int frames{1000};
+    int warmup_frames{60};
+    QSize size{1024, 768};
+    int meshes{1};
+    // Paths to measure; the modern one is skipped where not supported.
+    std::vector<GlPath> paths{GlPath::kLegacy, GlPath::kModern};
+    // Whole runs of `frames`, summarized in the JSON file.
+    bench::Options bench;
+    QString json_path;  // empty: log only
+  };
+
+  explicit GlHeadlessBenchmark(const Options& options) noexcept
+      : options_(options) {}
+
+  // Returns EXIT_SUCCESS, or EXIT_FAILURE when no context could be made.
+  int Run();
+
+ private:
+  Options options_;
+};
+
+#endif  // GL_HEADLESS_BENCHMARK_H
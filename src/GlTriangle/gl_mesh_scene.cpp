@@ -0,0 +1,73 @@
+#include "gl_mesh_scene.h"
+
+#include <cmath>
+
+#include <QtGui/QColor>
+
+namespace {
+constexpr float kPi{3.14159265f};
+
+// The original triangle.
+constexpr GLfloat kTriangle[]{
+    // x    y       R     G     B
+    0.0f,  0.707f, 1.0f, 0.0f, 0.0f,  //
+    -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,  //
+    0.5f,  -0.5f,  0.0f, 0.0f, 1.0f   //
+};
+
+void AddVertex(std::vector<GLfloat>* vertices, float x, float y,
+               const QColor& color) {
+  vertices->insert(vertices->end(),
+                   {x, y, float(color.redF()), float(color.greenF()),
+                    float(color.blueF())});
+}
+}  // namespace
+
+GlMeshScene::GlMeshScene(int mesh_count) {
+  view_projection_.perspective(60.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+  view_projection_.translate(0, 0, -2);
+
+  if (mesh_count <= 1) {
+    vertices_.assign(std::begin(kTriangle), std::end(kTriangle));
+    meshes_.push_back({0, 3});
+    return;
+  }
+
+  const int columns = int(std::ceil(std::sqrt(double(mesh_count))));
+  const float cell = 2.0f / columns;
+  meshes_.reserve(size_t(mesh_count));
+  for (int i = 0; i < mesh_count; ++i) {
+    Mesh mesh;
+    mesh.first = GLint(vertices_.size() / kVertexFloats);
+    mesh.x = -1.0f + cell * (i % columns + 0.5f);
+    mesh.y = -1.0f + cell * (i / columns + 0.5f);
+    mesh.scale = cell;
+    mesh.phase = i * 7.0f;
+
+    // A fan of `sides` triangles around a white center.
+    const int sides = 3 + i % 6;
+    const float hue = std::fmod(i * 0.618034f, 1.0f);
+    for (int k = 0; k < sides; ++k) {
+      const float a0 = kPi / 2 + 2 * kPi * k / sides;
+      const float a1 = kPi / 2 + 2 * kPi * (k + 1) / sides;
+      const QColor color =
+          QColor::fromHsvF(std::fmod(hue + float(k) / sides, 1.0f), 0.8f, 1);
+      AddVertex(&vertices_, 0, 0, Qt::white);
+      AddVertex(&vertices_, 0.45f * std::cos(a0), 0.45f * std::sin(a0),
+                color);
+      AddVertex(&vertices_, 0.45f * std::cos(a1), 0.45f * std::sin(a1),
+                color);
+    }
+    mesh.count = sides * 3;
+    meshes_.push_back(mesh);
+  }
+}
+
+QMatrix4x4 GlMeshScene::Matrix(int mesh, float angle) const noexcept {
+  const Mesh& m = meshes_[size_t(mesh)];
+  QMatrix4x4 matrix = view_projection_;
+  matrix.translate(m.x, m.y, 0);
+  matrix.scale(m.scale);
+  matrix.rotate(angle + m.phase, 0, 1, 0);
+  return matrix;
+}
@@ -0,0 +1,42 @@
+#ifndef GL_MESH_SCENE_H
+#define GL_MESH_SCENE_H
+
+#include <vector>
+
+#include <QtGui/QMatrix4x4>
+#include <QtGui/qopengl.h>
+
+// What both renderers draw. One mesh is the classic triangle; more make a
+// draw-call-heavy frame of distinct small meshes (polygons with 3 to 8
+// sides, each its own vertex range and matrix) on a grid, each spinning
+// around Y with its own phase.
+class GlMeshScene {
+ public:
+  struct Mesh {
+    GLint first{};  // vertex, GL_TRIANGLES
+    GLsizei count{};
+    float x{};
+    float y{};
+    float scale{1.0f};
+    float phase{};  // degrees
+  };
+
+  // x, y, r, g, b per vertex.
+  static constexpr int kVertexFloats{5};
+
+  explicit GlMeshScene(int mesh_count);
+
+  const std::vector<GLfloat>& vertices() const noexcept { return vertices_; }
+  const std::vector<Mesh>& meshes() const noexcept { return meshes_; }
+  int mesh_count() const noexcept { return int(meshes_.size()); }
+
+  // Model-view-projection of `mesh` at `angle` degrees around Y.
+  QMatrix4x4 Matrix(int mesh, float angle) const noexcept;
+
+ private:
+  std::vector<GLfloat> vertices_;
+  std::vector<Mesh> meshes_;
+  QMatrix4x4 view_projection_;
+};
+
+#endif  // GL_MESH_SCENE_H
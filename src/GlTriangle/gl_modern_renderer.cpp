@@ -0,0 +1,229 @@
+#include "gl_modern_renderer.h"
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QOffscreenSurface>
+
+#include "tracing.h"
+
+using namespace std::string_view_literals;
+
+namespace {
+constexpr auto kVertexShaderSource{
+    "#version 450 core\n"
+    "layout(location = 0) in vec2 position;\n"
+    "layout(location = 1) in vec3 color;\n"
+    "layout(location = 2) in mat4 matrix;  // per draw, by baseInstance\n"
+    "out vec3 v_color;\n"
+    "void main() {\n"
+    "   v_color = color;\n"
+    "   gl_Position = matrix * vec4(position, 0.0, 1.0);\n"
+    "}\n"sv};
+
+constexpr auto kFragmentShaderSource{
+    "#version 450 core\n"
+    "in vec3 v_color;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "   frag_color = vec4(v_color, 1.0);\n"
+    "}\n"sv};
+
+constexpr GLsizei kMatrixBytes{16 * sizeof(GLfloat)};
+constexpr GLbitfield kMapFlags{GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                               GL_MAP_COHERENT_BIT};
+constexpr GLuint64 kFenceTimeoutNs{1000000000};
+
+// Layout glMultiDrawArraysIndirect reads.
+struct DrawArraysIndirectCommand {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first;
+  GLuint base_instance;
+};
+}  // namespace
+
+const char* GlPathName(GlPath path) {
+  switch (path) {
+    case GlPath::kLegacy:
+      return "legacy";
+    case GlPath::kModern:
+      return "modern";
+  }
+  return "?";
+}
+
+QSurfaceFormat GlModernRenderer::Format() {
+  QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+  format.setRenderableType(QSurfaceFormat::OpenGL);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  format.setVersion(4, 5);
+  return format;
+}
+
+bool GlModernRenderer::IsSupported(const QOpenGLContext& context) {
+  // ARB_buffer_storage, ARB_multi_draw_indirect and ARB_direct_state_access
+  // are all core in 4.5, which QOpenGLFunctions_4_5_Core resolves as a set.
+  return !context.isOpenGLES() &&
+         context.format().version() >= qMakePair(4, 5);
+}
+
+bool GlModernRenderer::Probe() {
+  QOffscreenSurface surface;
+  surface.setFormat(Format());
+  surface.create();
+  QOpenGLContext context;
+  context.setFormat(Format());
+  if (!context.create() || !IsSupported(context) ||
+      !context.makeCurrent(&surface)) {
+    return false;
+  }
+  // Shaders and the persistent mapping can still fail on a 4.5 context.
+  const GlMeshScene scene(1);
+  GlModernRenderer renderer;
+  const bool ok = renderer.Init(&scene);
+  renderer.Release();
+  context.doneCurrent();
+  return ok;
+}
+
+bool GlModernRenderer::Init(const GlMeshScene* scene) {
+  if (!initializeOpenGLFunctions()) {
+    qWarning("OpenGL 4.5 core functions are not available");
+    return false;
+  }
+  scene_ = scene;
+
+  shader_program_ = new QOpenGLShaderProgram();
+  if (!shader_program_->addShaderFromSourceCode(
+          QOpenGLShader::Vertex, kVertexShaderSource.data()) ||
+      !shader_program_->addShaderFromSourceCode(
+          QOpenGLShader::Fragment, kFragmentShaderSource.data()) ||
+      !shader_program_->link()) {
+    qWarning("Failed to build the 4.5 shaders: %s",
+             qPrintable(shader_program_->log()));
+    Release();
+    return false;
+  }
+
+  const std::vector<GLfloat>& vertices = scene->vertices();
+  glCreateBuffers(1, &vertex_buffer_);
+  glNamedBufferStorage(vertex_buffer_,
+                       GLsizeiptr(vertices.size() * sizeof(GLfloat)),
+                       vertices.data(), 0);
+
+  std::vector<DrawArraysIndirectCommand> commands;
+  commands.reserve(scene->meshes().size());
+  for (const GlMeshScene::Mesh& mesh : scene->meshes()) {
+    commands.push_back({GLuint(mesh.count), 1, GLuint(mesh.first),
+                        GLuint(commands.size())});
+  }
+  glCreateBuffers(1, &indirect_buffer_);
+  glNamedBufferStorage(
+      indirect_buffer_,
+      GLsizeiptr(commands.size() * sizeof(DrawArraysIndirectCommand)),
+      commands.data(), 0);
+
+  region_bytes_ = GLsizeiptr(scene->mesh_count()) * kMatrixBytes;
+  glCreateBuffers(1, &matrix_buffer_);
+  glNamedBufferStorage(matrix_buffer_, kRegions * region_bytes_, nullptr,
+                       kMapFlags);
+  matrices_ = static_cast<char*>(glMapNamedBufferRange(
+      matrix_buffer_, 0, kRegions * region_bytes_, kMapFlags));
+  if (!matrices_) {
+    qWarning("Failed to map %lld bytes persistently",
+             static_cast<long long>(kRegions * region_bytes_));
+    Release();
+    return false;
+  }
+
+  glCreateVertexArrays(1, &vertex_array_);
+  glVertexArrayVertexBuffer(vertex_array_, 0, vertex_buffer_, 0,
+                            GlMeshScene::kVertexFloats * sizeof(GLfloat));
+  glVertexArrayAttribFormat(vertex_array_, 0, 2, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribFormat(vertex_array_, 1, 3, GL_FLOAT, GL_FALSE,
+                            2 * sizeof(GLfloat));
+  for (GLuint attrib : {0u, 1u}) {
+    glVertexArrayAttribBinding(vertex_array_, attrib, 0);
+    glEnableVertexArrayAttrib(vertex_array_, attrib);
+  }
+  // The matrix takes locations 2 to 5, one column each, and advances once
+  // per instance. Its buffer is bound per frame, at the current region.
+  for (GLuint column = 0; column < 4; ++column) {
+    glVertexArrayAttribFormat(vertex_array_, 2 + column, 4, GL_FLOAT,
+                              GL_FALSE, column * 4 * sizeof(GLfloat));
+    glVertexArrayAttribBinding(vertex_array_, 2 + column, 1);
+    glEnableVertexArrayAttrib(vertex_array_, 2 + column);
+  }
+  glVertexArrayBindingDivisor(vertex_array_, 1, 1);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  return true;
+}
+
+void GlModernRenderer::Release() {
+  if (!scene_) {
+    return;
+  }
+  for (GLsync& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (matrices_) {
+    glUnmapNamedBuffer(matrix_buffer_);
+    matrices_ = nullptr;
+  }
+  glDeleteVertexArrays(1, &vertex_array_);
+  const GLuint buffers[]{vertex_buffer_, indirect_buffer_, matrix_buffer_};
+  glDeleteBuffers(3, buffers);
+  vertex_array_ = vertex_buffer_ = indirect_buffer_ = matrix_buffer_ = 0;
+  delete shader_program_;
+  shader_program_ = nullptr;
+  scene_ = nullptr;
+}
+
+void GlModernRenderer::Render(const QSize& pixel_size, float angle) {
+  glViewport(0, 0, pixel_size.width(), pixel_size.height());
+
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // The GPU may still read this region from three frames ago.
+  if (GLsync fence = fences_[region_]) {
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      TRACE_SCOPE("gl", "FenceWait");
+      QElapsedTimer timer;
+      timer.start();
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              kFenceTimeoutNs) == GL_TIMEOUT_EXPIRED) {
+      }
+      fence_wait_ns_ += timer.nsecsElapsed();
+    }
+    glDeleteSync(fence);
+    fences_[region_] = nullptr;
+  }
+
+  // Coherent: plain stores, no flush, visible to the draw below.
+  const GLintptr offset = region_ * region_bytes_;
+  char* matrices = matrices_ + offset;
+  for (int i = 0; i < scene_->mesh_count(); ++i) {
+    std::memcpy(matrices + i * kMatrixBytes,
+                scene_->Matrix(i, angle).constData(), kMatrixBytes);
+  }
+
+  shader_program_->bind();
+  glBindVertexArray(vertex_array_);
+  glVertexArrayVertexBuffer(vertex_array_, 1, matrix_buffer_, offset,
+                            kMatrixBytes);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+  glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, scene_->mesh_count(), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindVertexArray(0);
+  shader_program_->release();
+
+  fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  region_ = (region_ + 1) % kRegions;
+}
@@ -0,0 +1,75 @@
+#ifndef GL_MODERN_RENDERER_H
+#define GL_MODERN_RENDERER_H
+
+#include <QtCore/QSize>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QSurfaceFormat>
+#if QT_VERSION_MAJOR==5
+#include <QtGui/QOpenGLFunctions_4_5_Core>
+#include <QtGui/QOpenGLShaderProgram>
+#else
+#include <QtOpenGL/QOpenGLFunctions_4_5_Core>
+#include <QtOpenGL/QOpenGLShaderProgram>
+#endif
+
+#include "gl_mesh_scene.h"
+
+enum class GlPath : quint8 { kLegacy, kModern };
+
+constexpr int kGlPathCount{2};
+
+// "legacy" or "modern", as on the command line and in the JSON files.
+const char* GlPathName(GlPath path);
+
+// The same scene as GlTriangleRenderer with the driver overhead taken out,
+// on a 4.5 core profile context:
+// - vertices and draw commands live in immutable buffers made with
+//   ARB_direct_state_access, so nothing is bound to be edited;
+// - the per-mesh matrices go to a persistently and coherently mapped
+//   ARB_buffer_storage buffer split in three regions; the CPU writes one
+//   while the GPU may still read the other two, and a fence per region
+//   makes it wait only when it gets three frames ahead;
+// - one glMultiDrawArraysIndirect draws every mesh. Each command's
+//   baseInstance selects its matrix through a per-instance attribute.
+class GlModernRenderer : protected QOpenGLFunctions_4_5_Core {
+ public:
+  // What to ask for, on the window or an offscreen context.
+  static QSurfaceFormat Format();
+  // Whether `context` has what this renderer needs.
+  static bool IsSupported(const QOpenGLContext& context);
+  // Creates a context with Format() on a throwaway surface and runs Init()
+  // on it, for a window that has to pick its format before it has a
+  // context.
+  static bool Probe();
+
+  // Both need the context current. `scene` must outlive the renderer.
+  bool Init(const GlMeshScene* scene);
+  void Release();
+
+  // `angle` in degrees around the Y axis.
+  void Render(const QSize& pixel_size, float angle);
+
+  // Time Render() spent waiting for a region the GPU had not released.
+  qint64 TakeFenceWaitNs() noexcept {
+    const qint64 ns = fence_wait_ns_;
+    fence_wait_ns_ = 0;
+    return ns;
+  }
+
+ private:
+  static constexpr int kRegions{3};
+
+  const GlMeshScene* scene_{};
+  QOpenGLShaderProgram* shader_program_{};
+  GLuint vertex_array_{};
+  GLuint vertex_buffer_{};
+  GLuint indirect_buffer_{};
+  GLuint matrix_buffer_{};
+  GLsizeiptr region_bytes_{};
+  char* matrices_{};  // mapped for the lifetime of matrix_buffer_
+  GLsync fences_[kRegions]{};
+  int region_{};
+  qint64 fence_wait_ns_{};
+};
+
+#endif  // GL_MODERN_RENDERER_H
@@ -0,0 +1,76 @@
+#include "gl_triangle_renderer.h"
+
+#include <string_view>
+
+using namespace std::string_view_literals;
+
+namespace {
+constexpr auto kVertexShaderSource{
+    "attribute highp vec4 posAttr;\n"
+    "attribute lowp vec4 colAttr;\n"
+    "varying lowp vec4 col;\n"
+    "uniform highp mat4 matrix;\n"
+    "void main() {\n"
+    "   col = colAttr;\n"
+    "   gl_Position = matrix * posAttr;\n"
+    "}\n"sv};
+
+constexpr auto kFragmentShaderSource{
+    "varying lowp vec4 col;\n"
+    "void main() {\n"
+    "   gl_FragColor = col;\n"
+    "}\n"sv};
+}  // namespace
+
+void GlTriangleRenderer::Init(const GlMeshScene* scene) {
+  initializeOpenGLFunctions();
+  scene_ = scene;
+
+  shader_program_ = new QOpenGLShaderProgram();
+  shader_program_->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                           kVertexShaderSource.data());
+  shader_program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                           kFragmentShaderSource.data());
+  shader_program_->link();
+  pos_ = shader_program_->attributeLocation("posAttr");
+  Q_ASSERT(pos_ != -1);
+  col_ = shader_program_->attributeLocation("colAttr");
+  Q_ASSERT(col_ != -1);
+  matrix_uniform_ = shader_program_->uniformLocation("matrix");
+  Q_ASSERT(matrix_uniform_ != -1);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void GlTriangleRenderer::Release() {
+  delete shader_program_;
+  shader_program_ = nullptr;
+}
+
+void GlTriangleRenderer::Render(const QSize& pixel_size, float angle) {
+  glViewport(0, 0, pixel_size.width(), pixel_size.height());
+
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  shader_program_->bind();
+
+  constexpr GLsizei kStride{GlMeshScene::kVertexFloats * sizeof(GLfloat)};
+  const GLfloat* vertices = scene_->vertices().data();
+  glVertexAttribPointer(pos_, 2, GL_FLOAT, GL_FALSE, kStride, vertices);
+  glVertexAttribPointer(col_, 3, GL_FLOAT, GL_FALSE, kStride, vertices + 2);
+
+  glEnableVertexAttribArray(pos_);
+  glEnableVertexAttribArray(col_);
+
+  for (int i = 0; i < scene_->mesh_count(); ++i) {
+    const GlMeshScene::Mesh& mesh = scene_->meshes()[size_t(i)];
+    shader_program_->setUniformValue(matrix_uniform_,
+                                     scene_->Matrix(i, angle));
+    glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+  }
+
+  glDisableVertexAttribArray(pos_);
+  glDisableVertexAttribArray(col_);
+
+  shader_program_->release();
+}
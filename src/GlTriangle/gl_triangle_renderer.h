@@ -0,0 +1,35 @@
+#ifndef GL_TRIANGLE_RENDERER_H
+#define GL_TRIANGLE_RENDERER_H
+
+#include <QtCore/QSize>
+#include <QtGui/QOpenGLFunctions>
+#if QT_VERSION_MAJOR==5
+#include <QtGui/QOpenGLShaderProgram>
+#else
+#include <QtOpenGL/QOpenGLShaderProgram>
+#endif
+
+#include "gl_mesh_scene.h"
+
+// Draws the scene into whatever framebuffer is bound, so the window and the
+// headless benchmark render exactly the same thing. GLES2-style: client-side
+// vertex arrays, and per mesh one matrix upload and one draw call. Works on
+// any ES or compatibility context; the fallback for GlModernRenderer.
+class GlTriangleRenderer : protected QOpenGLFunctions {
+ public:
+  // Both need the context current. `scene` must outlive the renderer.
+  void Init(const GlMeshScene* scene);
+  void Release();
+
+  // `angle` in degrees around the Y axis.
+  void Render(const QSize& pixel_size, float angle);
+
+ private:
+  const GlMeshScene* scene_{};
+  QOpenGLShaderProgram* shader_program_{};
+  GLint pos_{};
+  GLint col_{};
+  GLint matrix_uniform_{};
+};
+
+#endif  // GL_TRIANGLE_RENDERER_H
@@ -1,100 +1,66 @@
 #include "gl_triangle_window.h"
 
-#include <array>
-#include <string_view>
-
 #include <QtGui/QScreen>
-#include <QtGui/QVector3D>
-
-using namespace std::string_view_literals;
-
-namespace {
-constexpr auto kVertexShaderSource{
-    "attribute highp vec4 posAttr;\n"
-    "attribute lowp vec4 colAttr;\n"
-    "varying lowp vec4 col;\n"
-    "uniform highp mat4 matrix;\n"
-    "void main() {\n"
-    "   col = colAttr;\n"
-    "   gl_Position = matrix * posAttr;\n"
-    "}\n"sv};
 
-constexpr auto kFragmentShaderSource{
-    "varying lowp vec4 col;\n"
-    "void main() {\n"
-    "   gl_FragColor = col;\n"
-    "}\n"sv};
-}  // namespace
+#include "tracing.h"
 
-GlTriangleWindow::GlTriangleWindow(QWindow* parent)
-    : QOpenGLWindow(NoPartialUpdate, parent), animate_timer_{new QTimer(this)} {
+GlTriangleWindow::GlTriangleWindow(GlPath path,
+                                   int mesh_count,
+                                   QWindow* parent)
+    : QOpenGLWindow(NoPartialUpdate, parent),
+      path_(path),
+      scene_(mesh_count),
+      animate_timer_{new QTimer(this)} {
   animate_timer_->setInterval(30);
   connect(animate_timer_, &QTimer::timeout, this, &GlTriangleWindow::OnTimer);
 }
 
-GlTriangleWindow::~GlTriangleWindow() {}
+GlTriangleWindow::~GlTriangleWindow() {
+  makeCurrent();
+  if (path_ == GlPath::kModern) {
+    modern_renderer_.Release();
+  } else {
+    renderer_.Release();
+  }
+  doneCurrent();
+}
 
 void GlTriangleWindow::initializeGL() {
-  initializeOpenGLFunctions();
-
-  shader_program_ = new QOpenGLShaderProgram(this);
-  shader_program_->addShaderFromSourceCode(QOpenGLShader::Vertex,
-                                           kVertexShaderSource.data());
-  shader_program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
-                                           kFragmentShaderSource.data());
-  shader_program_->link();
-  pos_ = shader_program_->attributeLocation("posAttr");
-  Q_ASSERT(pos_ != -1);
-  col_ = shader_program_->attributeLocation("colAttr");
-  Q_ASSERT(col_ != -1);
-  matrix_uniform_ = shader_program_->uniformLocation("matrix");
-  Q_ASSERT(matrix_uniform_ != -1);
-
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  if (path_ == GlPath::kModern) {
+    if (!GlModernRenderer::IsSupported(*context()) ||
+        !modern_renderer_.Init(&scene_)) {
+      qFatal("The OpenGL 4.5 path failed after probing fine");
+    }
+  } else {
+    renderer_.Init(&scene_);
+  }
+  qInfo("GlTriangle: %s path, %d meshes", GlPathName(path_),
+        scene_.mesh_count());
   animate_timer_->start();
 }
 
-void GlTriangleWindow::resizeGL(int w, int h) {
-  glViewport(0, 0, w, h);
-}
-
 void GlTriangleWindow::paintGL() {
+  TRACE_SCOPE("gl", "paintGL");
+  // From the latest timer tick that requested this frame; earlier ones that
+  // were coalesced into it keep their flows open.
+  if (tick_ != painted_tick_) {
+    TRACE_FLOW_END("gl", "update", tick_);
+    painted_tick_ = tick_;
+  }
   const qreal retina_scale = devicePixelRatio();
-  glViewport(0, 0, width() * retina_scale, height() * retina_scale);
-
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  shader_program_->bind();
-
-  QMatrix4x4 matrix;
-  matrix.perspective(60.0f, 4.0f / 3.0f, 0.1f, 100.0f);
-  matrix.translate(0, 0, -2);
-  matrix.rotate(100.0f * frame_ / screen()->refreshRate(), 0, 1, 0);
-
-  shader_program_->setUniformValue(matrix_uniform_, matrix);
-
-  constexpr std::array<GLfloat, 6> kVertices{0.0f,  0.707f, -0.5f,
-                                             -0.5f, 0.5f,   -0.5f};
-
-  constexpr std::array<GLfloat, 9> kColors{1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-                                           0.0f, 0.0f, 0.0f, 1.0f};
-
-  glVertexAttribPointer(pos_, 2, GL_FLOAT, GL_FALSE, 0, kVertices.data());
-  glVertexAttribPointer(col_, 3, GL_FLOAT, GL_FALSE, 0, kColors.data());
-
-  glEnableVertexAttribArray(pos_);
-  glEnableVertexAttribArray(col_);
-
-  glDrawArrays(GL_TRIANGLES, 0, 3);
-
-  glDisableVertexAttribArray(pos_);
-  glDisableVertexAttribArray(col_);
-
-  shader_program_->release();
-
+  const QSize pixel_size = size() * retina_scale;
+  const float angle = 100.0f * frame_ / screen()->refreshRate();
+  if (path_ == GlPath::kModern) {
+    modern_renderer_.Render(pixel_size, angle);
+  } else {
+    renderer_.Render(pixel_size, angle);
+  }
   ++frame_;
 }
 
 void GlTriangleWindow::OnTimer() {
+  TRACE_SCOPE("gl", "OnTimer");
+  ++tick_;
+  TRACE_FLOW_BEGIN("gl", "update", tick_);
   update();
 }
@@ -2,36 +2,43 @@
 #define GL_TRIANGLE_WINDOW_H
 
 #include <QtCore/QTimer>
-#include <QtGui/QOpenGLFunctions>
 #if QT_VERSION_MAJOR==5
-#include <QtGui/QOpenGLShaderProgram>
 #include <QtGui/QOpenGLWindow>
 #else
-#include <QtOpenGL/QOpenGLShaderProgram>
 #include <QtOpenGL/QOpenGLWindow>
 #endif
 
-class GlTriangleWindow : public QOpenGLWindow, protected QOpenGLFunctions {
+#include "gl_mesh_scene.h"
+#include "gl_modern_renderer.h"
+#include "gl_triangle_renderer.h"
+
+class GlTriangleWindow : public QOpenGLWindow {
   Q_OBJECT
 
  public:
-  GlTriangleWindow(QWindow* parent = nullptr);
+  // With GlPath::kModern the window must have GlModernRenderer::Format()
+  // and GlModernRenderer::Probe() must have succeeded: the legacy renderer
+  // cannot draw on a core profile context, so there is no fallback left.
+  GlTriangleWindow(GlPath path, int mesh_count, QWindow* parent = nullptr);
   ~GlTriangleWindow();
 
  protected:
   void initializeGL() override;
-  void resizeGL(int w, int h) override;
   void paintGL() override;
 
  private:
   void OnTimer();
 
  private:
-  QOpenGLShaderProgram* shader_program_{};
-  GLint pos_{};
-  GLint col_{};
-  GLint matrix_uniform_{};
+  GlPath path_;
+  GlMeshScene scene_;
+  GlTriangleRenderer renderer_;
+  GlModernRenderer modern_renderer_;
   int frame_{};
+  // Trace flow ids. Ticks that arrive before the next paint coalesce into one
+  // frame, so frames and ticks do not pair up.
+  int tick_{};
+  int painted_tick_{};
   QTimer* animate_timer_;
 };
 
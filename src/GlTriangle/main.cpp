@@ -1,17 +1,78 @@
+#include <vector>
+
+#include <QtCore/QCommandLineParser>
 #include <QtCore/QDebug>
 #include <QtGui/QGuiApplication>
 
+#include "bench.h"
+#include "gl_headless_benchmark.h"
 #include "gl_triangle_window.h"
+#include "tracing.h"
 
 int main(int argc, char* argv[]) {
   QGuiApplication a(argc, argv);
+  tracing::StartFromEnvironment();  // TRACE_FILE=gl.json GlTriangle
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  const QCommandLineOption headless_option(
+      "headless", "Render offscreen as fast as possible and report timings.");
+  const QCommandLineOption frames_option("frames", "Frames to measure.",
+                                         "n", "1000");
+  const QCommandLineOption meshes_option(
+      "meshes", "Distinct meshes drawn per frame.", "n", "1");
+  const QCommandLineOption path_option(
+      "path",
+      "legacy (GLES2 style, one draw call per mesh), modern (4.5 core, "
+      "persistent buffers and one multi-draw), or all: the window takes "
+      "modern where supported, headless compares both.",
+      "path", "all");
+  const QCommandLineOption json_option(
+      "json", "Write headless results as JSON to <file>.", "file");
+  parser.addOptions({headless_option, frames_option, meshes_option,
+                     path_option, json_option});
+  bench::AddOptions(&parser);
+  parser.process(a);
+
+  std::vector<GlPath> paths;
+  for (int i = 0; i < kGlPathCount; ++i) {
+    if (parser.value(path_option) == "all" ||
+        parser.value(path_option) == GlPathName(GlPath(i))) {
+      paths.push_back(GlPath(i));
+    }
+  }
+  if (paths.empty()) {
+    qCritical() << "Unknown path" << parser.value(path_option);
+    return EXIT_FAILURE;
+  }
+  const int meshes = parser.value(meshes_option).toInt();
+
+  if (parser.isSet(headless_option)) {
+    GlHeadlessBenchmark::Options options;
+    options.frames = parser.value(frames_option).toInt();
+    options.meshes = meshes;
+    options.paths = paths;
+    options.bench = bench::ParseOptions(parser);
+    options.json_path = parser.value(json_option);
+    return GlHeadlessBenchmark(options).Run();
+  }
 
   if (!QGuiApplication::primaryScreen()) {
     qCritical() << "No screens available!";
     return EXIT_FAILURE;
   }
 
-  GlTriangleWindow window{};
+  // The window picks its format before it has a context, so try the modern
+  // path on a throwaway one first; it only falls back from here.
+  GlPath path = paths.back();
+  if (path == GlPath::kModern && !GlModernRenderer::Probe()) {
+    qWarning() << "OpenGL 4.5 core path unavailable, using the legacy path";
+    path = GlPath::kLegacy;
+  }
+  GlTriangleWindow window(path, meshes);
+  if (path == GlPath::kModern) {
+    window.setFormat(GlModernRenderer::Format());
+  }
   if (!window.winId()) {
     qCritical() << "Failed to create window!";
     return EXIT_FAILURE;
@@ -0,0 +1,217 @@
+#include "feed_benchmark.h"
+
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QTimer>
+#include <QtMultimedia/QAudioDeviceInfo>
+#include <QtMultimedia/QAudioFormat>
+#include <QtMultimedia/QAudioOutput>
+
+#include "traced_file.h"
+
+namespace {
+// The format main() opens the device with: 48 kHz, stereo, s16le.
+constexpr int kSampleRate{48000};
+constexpr int kChannels{2};
+constexpr int kBytesPerSecond{kSampleRate * kChannels * 2};
+
+// Times every pull. Qt 5's audio backends pull on the thread that started
+// the output, so the samples need no lock.
+class TimedFile : public TracedFile {
+ public:
+  using TracedFile::TracedFile;
+
+  std::vector<double> TakeReadsUs() {
+    std::vector<double> reads;
+    reads.swap(reads_us_);
+    return reads;
+  }
+
+ protected:
+  qint64 readData(char* data, qint64 max_size) override {
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 size = TracedFile::readData(data, max_size);
+    reads_us_.push_back(timer.nsecsElapsed() / 1e3);
+    return size;
+  }
+
+ private:
+  std::vector<double> reads_us_;
+};
+
+bool WriteSine(QFile* file, int seconds) {
+  constexpr double kPi{3.14159265358979323846};
+  std::vector<qint16> second(size_t(kSampleRate) * kChannels);
+  for (int i = 0; i < kSampleRate; ++i) {
+    const auto sample =
+        qint16(8192 * std::sin(2 * kPi * 440 * i / kSampleRate));
+    second[size_t(i) * 2] = sample;
+    second[size_t(i) * 2 + 1] = sample;
+  }
+  const QByteArray bytes(reinterpret_cast<const char*>(second.data()),
+                         int(second.size() * sizeof(qint16)));
+  for (int i = 0; i < seconds; ++i) {
+    if (file->write(bytes) != bytes.size()) {
+      return false;
+    }
+  }
+  return file->flush();
+}
+
+QAudioFormat PlayerFormat() {
+  QAudioFormat format;
+  format.setChannelCount(kChannels);
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  format.setCodec("audio/pcm");
+  format.setSampleRate(kSampleRate);
+  format.setSampleSize(16);
+  format.setSampleType(QAudioFormat::SignedInt);
+  return format;
+}
+
+// First output device whose name contains `name`; the default one for an
+// empty name. Null if there is none.
+QAudioDeviceInfo FindDevice(const QString& name) {
+  if (name.isEmpty()) {
+    return QAudioDeviceInfo::defaultOutputDevice();
+  }
+  const auto devices = QAudioDeviceInfo::availableDevices(QAudio::AudioOutput);
+  for (const QAudioDeviceInfo& device : devices) {
+    if (device.deviceName().contains(name)) {
+      return device;
+    }
+  }
+  return {};
+}
+}  // namespace
+
+int FeedBenchmark::Run() {
+  QTemporaryFile generated;
+  QString path = options_.pcm_path;
+  if (path.isEmpty()) {
+    if (!generated.open() || !WriteSine(&generated, options_.seconds)) {
+      qCritical("Failed to generate %d s of PCM", options_.seconds);
+      return EXIT_FAILURE;
+    }
+    path = generated.fileName();
+  }
+
+  TimedFile pcm_file(path);
+  if (!pcm_file.open(QIODevice::ReadOnly) || pcm_file.size() == 0) {
+    qCritical("Failed to open %s", qPrintable(path));
+    return EXIT_FAILURE;
+  }
+  const double audio_seconds = double(pcm_file.size()) / kBytesPerSecond;
+
+  const QString device_name = options_.device.isEmpty()
+                                  ? qEnvironmentVariable("PULSE_SINK")
+                                  : options_.device;
+  const QAudioDeviceInfo device = FindDevice(device_name);
+  const QAudioFormat format = PlayerFormat();
+  if (device.isNull() || !device.isFormatSupported(format)) {
+    qCritical("No audio output %s for 48 kHz stereo s16le; without a sound "
+              "card load a null sink, see feed_benchmark.h",
+              qPrintable(device_name));
+    return EXIT_FAILURE;
+  }
+  qInfo("Feed benchmark: %.1f s of audio into %s", audio_seconds,
+        qPrintable(device.deviceName()));
+
+  bench::Suite suite("PcmPlayer.feed");
+  QJsonObject run;
+  const bool ok = suite.Run(options_.bench, [&] {
+    if (!pcm_file.seek(0)) {
+      return false;
+    }
+    pcm_file.TakeReadsUs();
+
+    QAudioOutput output(device, format);
+    QEventLoop loop;
+    int underruns{};
+    bool finished{false};
+    QObject::connect(&output, &QAudioOutput::stateChanged, &loop,
+                     [&](QAudio::State state) {
+                       if (state == QAudio::IdleState) {
+                         if (pcm_file.atEnd()) {
+                           finished = true;
+                           output.stop();
+                         } else {
+                           ++underruns;  // ran dry before the file did
+                         }
+                       } else if (state == QAudio::StoppedState) {
+                         loop.quit();
+                       }
+                     });
+    QTimer::singleShot(int(audio_seconds * 2000) + 10000, &loop, [&] {
+      output.stop();
+      loop.quit();
+    });
+
+    QElapsedTimer timer;
+    const std::clock_t cpu_start = std::clock();
+    timer.start();
+    output.start(&pcm_file);
+    if (output.error() != QAudio::NoError) {
+      qCritical("Failed to start playback: %d", int(output.error()));
+      return false;
+    }
+    loop.exec();
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    const double cpu_us =
+        double(std::clock() - cpu_start) * 1e6 / CLOCKS_PER_SEC;
+    if (!finished) {
+      qCritical("Playback did not finish within %.0f s", seconds);
+      return false;
+    }
+
+    const bench::Summary reads = bench::Summarize(pcm_file.TakeReadsUs());
+    const double cpu_per_second = cpu_us / audio_seconds;
+    const double realtime = seconds > 0 ? audio_seconds / seconds : -1;
+    qInfo("    played in s    = %.2f (%.3fx real time)", seconds, realtime);
+    qInfo("    read us        = %.2f median, %.2f max (%d reads)",
+          reads.median, reads.max, reads.count);
+    qInfo("    cpu us / s     = %.0f", cpu_per_second);
+    if (underruns) {
+      qWarning("    underruns      = %d", underruns);
+    }
+    run = {{"device", device.deviceName()},
+           {"buffer_bytes", output.bufferSize()},
+           {"reads", reads.count},
+           {"underruns", underruns},
+           {"read_median_us", reads.median},
+           {"read_max_us", reads.max},
+           {"cpu_us_per_audio_second", cpu_per_second},
+           {"realtime_ratio", realtime}};
+    suite.AddJson({}, run);
+    return true;
+  });
+  if (!ok) {
+    return EXIT_FAILURE;
+  }
+  suite.Log();
+
+  if (options_.json_path.isEmpty()) {
+    return EXIT_SUCCESS;
+  }
+  const QJsonObject json{{"benchmark", "PcmPlayer.feed"},
+                         {"audio_seconds", audio_seconds},
+                         {"runs", QJsonArray{run}},
+                         {"bench", suite.ToJson()}};
+  QFile file(options_.json_path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Failed to write %s", qPrintable(options_.json_path));
+    return EXIT_FAILURE;
+  }
+  file.write(QJsonDocument(json).toJson());
+  return EXIT_SUCCESS;
+}
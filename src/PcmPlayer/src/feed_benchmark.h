@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtCore/QString>
+
+#include "bench.h"
+
+// Plays PCM through the player's own path, QAudioOutput pulling from a
+// TracedFile, and measures that path: how long each pull takes, how much CPU
+// a second of audio costs, whether the device ran dry, and whether playback
+// kept up with real time. It plays in real time, so keep the audio short.
+//
+// Meant for a sink nobody listens to, e.g. a PulseAudio/PipeWire null sink:
+//   pactl load-module module-null-sink sink_name=bench_null
+//   PULSE_SINK=bench_null PcmPlayer --bench --device bench_null
+// Without a file it generates a sine wave in the player's format.
+class FeedBenchmark {
+ public:
+  struct Options {
+    QString pcm_path;  // empty: generated
+    int seconds{5};    // length of the generated audio
+    // Output device whose name contains this, empty: $PULSE_SINK, else the
+    // default device.
+    QString device;
+    bench::Options bench;
+    QString json_path;  // empty: log only
+  };
+
+  explicit FeedBenchmark(const Options& options) noexcept
+      : options_(options) {}
+
+  // Returns EXIT_SUCCESS, or EXIT_FAILURE if there is nothing to read, no
+  // usable output device, or playback never finished.
+  int Run();
+
+ private:
+  Options options_;
+};
@@ -1,22 +1,35 @@
+#include <QtCore/QCommandLineParser>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
-#include <QtCore/QFile>
 #include <QtCore/QLocale>
 #include <QtCore/QTranslator>
 #include <QtMultimedia/QAudioFormat>
 #include <QtMultimedia/QAudioOutput>
 
+#include "bench.h"
+#include "feed_benchmark.h"
+#include "traced_file.h"
+#include "tracing.h"
+
 // 准备 PCM 文件，可用 ffmpeg 转换：
 // ffmpeg -i "X.mp3" -f s16le -ar 48000 -ac 2 test.pcm
 
 // 播放：
 // PcmPlayer test.pcm
 
+// 跟踪喂数据路径：
+// TRACE_FILE=pcm.json PcmPlayer test.pcm
+
+// 喂数据基准测试（不给文件则生成正弦波），经 QAudioOutput 实时播放到空输出：
+// pactl load-module module-null-sink sink_name=bench_null
+// PcmPlayer --bench --device bench_null --json feed.json [test.pcm]
+
 int main(int argc, char* argv[]) {
   QCoreApplication app(argc, argv);
   qSetMessagePattern(
       "%{time yyyy-MM-ddThh:mm:ss.zzz} |%{pid}~%{threadid} <%{type}> "
       "%{message}");
+  tracing::StartFromEnvironment();
 
   QTranslator translator;
   const QStringList kUiLanguages = QLocale::system().uiLanguages();
@@ -28,13 +41,43 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  if (argc < 2) {
+  QCommandLineParser parser;
+  const QCommandLineOption bench_option(
+      "bench", "Play the PCM into an output nobody listens to and measure "
+      "the feed path.");
+  const QCommandLineOption seconds_option(
+      "seconds", "Audio to generate when benchmarking without a file.", "s",
+      "5");
+  const QCommandLineOption device_option(
+      "device",
+      "Benchmark on the output whose name contains <name>, default "
+      "$PULSE_SINK.",
+      "name");
+  const QCommandLineOption json_option(
+      "json", "Write benchmark results as JSON to <file>.", "file");
+  parser.addOptions(
+      {bench_option, seconds_option, device_option, json_option});
+  bench::AddOptions(&parser);
+  parser.process(app);
+  const QStringList arguments = parser.positionalArguments();
+
+  if (parser.isSet(bench_option)) {
+    FeedBenchmark::Options options;
+    options.pcm_path = arguments.value(0);
+    options.seconds = parser.value(seconds_option).toInt();
+    options.device = parser.value(device_option);
+    options.bench = bench::ParseOptions(parser);
+    options.json_path = parser.value(json_option);
+    return FeedBenchmark(options).Run();
+  }
+
+  if (arguments.isEmpty()) {
     qInfo() << QObject::tr("Usage: PcmPlayer pcm_file");
     return EXIT_SUCCESS;
   }
 
-  auto pcm_file = new QFile(&app);
-  pcm_file->setFileName(argv[1]);
+  auto pcm_file = new TracedFile(&app);
+  pcm_file->setFileName(arguments.first());
   if (!pcm_file->open(QIODevice::ReadOnly)) {
     qCritical() << QObject::tr("Open PCM file failed!");
     return EXIT_FAILURE;
@@ -59,6 +102,7 @@ int main(int argc, char* argv[]) {
   qDebug() << audio_output->error();
   audio_output->connect(audio_output, &QAudioOutput::stateChanged,
                         [&app, audio_output, pcm_file](QAudio::State state) {
+                          TRACE_INSTANT("audio", "StateChanged");
                           if (QAudio::IdleState == state) {
                             audio_output->stop();
                             pcm_file->close();
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QtCore/QFile>
+
+#include "tracing.h"
+
+// QAudioOutput pulls the samples through readData(), on whichever thread the
+// audio backend feeds from, so this is the feed path.
+class TracedFile : public QFile {
+ public:
+  using QFile::QFile;
+
+ protected:
+  qint64 readData(char* data, qint64 max_size) override {
+    TRACE_SCOPE("audio", "ReadPcm");
+    const qint64 size = QFile::readData(data, max_size);
+    TRACE_COUNTER("audio", "pcm_bytes_read", size);
+    return size;
+  }
+};
@@ -0,0 +1,101 @@
+// https://doc.qt.io/qt-6/qtgui-rhiwindow-example.html
+// Needs Qt 6.6 or later for the public QRhi API.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <QtCore/QCommandLineParser>
+#include <QtGui/QGuiApplication>
+#include <QtGui/QVulkanInstance>
+
+#include "bench.h"
+#include "rhi_headless_benchmark.h"
+#include "rhi_triangle_window.h"
+#include "tracing.h"
+
+int main(int argc, char* argv[]) {
+  // A headless Vulkan run must not need a display, so pick the offscreen
+  // platform before QGuiApplication looks for one. OpenGL still needs a
+  // real one (or xvfb-run) for its context.
+  bool headless{};
+  bool opengl{true};
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "--headless")) {
+      headless = true;
+    }
+    if (0 == std::strcmp(argv[i], "--backend") && i + 1 < argc) {
+      opengl = 0 != std::strcmp(argv[i + 1], "vulkan");
+    }
+  }
+  if (headless && !opengl && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+
+  QGuiApplication app(argc, argv);
+  tracing::StartFromEnvironment();
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  const QCommandLineOption backend_option(
+      "backend",
+      "opengl, vulkan, or all to compare them one after another (headless; "
+      "the window then uses opengl).",
+      "backend", "all");
+  const QCommandLineOption headless_option(
+      "headless", "Render offscreen as fast as possible and report timings.");
+  const QCommandLineOption frames_option("frames", "Frames to measure.",
+                                         "n", "1000");
+  const QCommandLineOption instances_option(
+      "instances", "Triangles drawn per frame, in one instanced draw.", "n",
+      "1");
+  const QCommandLineOption json_option(
+      "json", "Write headless results as JSON to <file>.", "file");
+  parser.addOptions({backend_option, headless_option, frames_option,
+                     instances_option, json_option});
+  bench::AddOptions(&parser);
+  parser.process(app);
+
+  std::vector<RhiBackend> backends;
+  for (int i = 0; i < kRhiBackendCount; ++i) {
+    const auto backend = RhiBackend(i);
+    if (parser.value(backend_option) == "all" ||
+        parser.value(backend_option) == RhiBackendName(backend)) {
+      backends.push_back(backend);
+    }
+  }
+  if (backends.empty()) {
+    qCritical("Unknown backend %s", qPrintable(parser.value(backend_option)));
+    return EXIT_FAILURE;
+  }
+
+  // Only needed for Vulkan; without a loader the OpenGL backend still works.
+  QVulkanInstance inst;
+  const bool vulkan =
+      std::find(backends.begin(), backends.end(), RhiBackend::kVulkan) !=
+      backends.end();
+  if (vulkan) {
+    inst.setExtensions(QRhiVulkanInitParams::preferredInstanceExtensions());
+    if (!inst.create()) {
+      qWarning("Failed to create Vulkan instance: %d", inst.errorCode());
+    }
+  }
+
+  if (parser.isSet(headless_option)) {
+    RhiHeadlessBenchmark::Options options;
+    options.backends = backends;
+    options.skip_unavailable = parser.value(backend_option) == "all";
+    options.frames = parser.value(frames_option).toInt();
+    options.instances = parser.value(instances_option).toInt();
+    options.bench = bench::ParseOptions(parser);
+    options.json_path = parser.value(json_option);
+    return RhiHeadlessBenchmark(&inst, options).Run();
+  }
+
+  RhiTriangleWindow w(backends.front(), &inst,
+                      parser.value(instances_option).toInt());
+  w.resize(1024, 768);
+  w.show();
+
+  return app.exec();
+}
@@ -0,0 +1,26 @@
+#version 440
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec3 color;
+// Per instance: grid offset in xy, cell size, extra rotation in degrees.
+layout(location = 2) in vec4 instance;
+
+layout(location = 0) out vec3 v_color;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 projection;  // includes the backend's clip space correction
+    float rotation;   // degrees
+} ubuf;
+
+out gl_PerVertex { vec4 gl_Position; };
+
+// projection * translate(offset) * scale(cell) * rotate(angle, 0, 1, 0),
+// the matrix TriangleScene::ObjectMatrix() builds per draw on the CPU.
+void main()
+{
+    v_color = color;
+    const float a = radians(ubuf.rotation + instance.w);
+    const vec3 p = vec3(position.x * cos(a), position.y, -position.x * sin(a));
+    gl_Position = ubuf.projection * vec4(instance.xy + instance.z * p.xy,
+                                         instance.z * p.z, 1.0);
+}
@@ -0,0 +1,49 @@
+#include "rhi_backend.h"
+
+const char* RhiBackendName(RhiBackend backend) {
+  switch (backend) {
+    case RhiBackend::kOpenGL:
+      return "opengl";
+    case RhiBackend::kVulkan:
+      return "vulkan";
+  }
+  return "?";
+}
+
+QSurface::SurfaceType RhiSurfaceType(RhiBackend backend) {
+  return backend == RhiBackend::kVulkan ? QSurface::VulkanSurface
+                                        : QSurface::OpenGLSurface;
+}
+
+std::unique_ptr<QRhi> CreateRhi(
+    RhiBackend backend,
+    QWindow* window,
+    QVulkanInstance* vulkan_instance,
+    std::unique_ptr<QOffscreenSurface>* fallback_surface) {
+  const QRhi::Flags flags = QRhi::EnableTimestamps;
+  QRhi* rhi{};
+  switch (backend) {
+    case RhiBackend::kOpenGL: {
+      fallback_surface->reset(QRhiGles2InitParams::newFallbackSurface());
+      QRhiGles2InitParams params;
+      params.fallbackSurface = fallback_surface->get();
+      params.window = window;
+      rhi = QRhi::create(QRhi::OpenGLES2, &params, flags);
+      break;
+    }
+    case RhiBackend::kVulkan: {
+      if (!vulkan_instance || !vulkan_instance->isValid()) {
+        break;
+      }
+      QRhiVulkanInitParams params;
+      params.inst = vulkan_instance;
+      params.window = window;
+      rhi = QRhi::create(QRhi::Vulkan, &params, flags);
+      break;
+    }
+  }
+  if (!rhi) {
+    qWarning("Failed to create a QRhi for %s", RhiBackendName(backend));
+  }
+  return std::unique_ptr<QRhi>(rhi);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QVulkanInstance>
+#include <QtGui/QWindow>
+#include <rhi/qrhi.h>
+
+enum class RhiBackend : quint8 { kOpenGL, kVulkan };
+
+constexpr int kRhiBackendCount{2};
+
+// "opengl" or "vulkan", as on the command line and in the JSON files.
+const char* RhiBackendName(RhiBackend backend);
+
+QSurface::SurfaceType RhiSurfaceType(RhiBackend backend);
+
+// Creates a QRhi for `window`, or an offscreen one when `window` is null.
+// `vulkan_instance` is only used, and must then be created, for kVulkan.
+// OpenGL needs a surface of its own for when no window is current; it is
+// stored in `fallback_surface` and has to outlive the QRhi. GPU timestamps
+// are enabled where the backend has them. Returns null if the backend is not
+// available.
+std::unique_ptr<QRhi> CreateRhi(
+    RhiBackend backend,
+    QWindow* window,
+    QVulkanInstance* vulkan_instance,
+    std::unique_ptr<QOffscreenSurface>* fallback_surface);
@@ -0,0 +1,157 @@
+#include "rhi_headless_benchmark.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+
+#include "rhi_scene.h"
+#include "tracing.h"
+
+int RhiHeadlessBenchmark::Run() {
+  qInfo("RhiTriangle headless");
+  qInfo("  frames           = %d (%dx%d)", options_.frames,
+        options_.size.width(), options_.size.height());
+  qInfo("  instances        = %d", options_.instances);
+
+  bench::Suite suite("RhiTriangle.headless");
+  QJsonArray runs;
+  bool ok = true;
+  int measured{};
+  for (RhiBackend backend : options_.backends) {
+    std::unique_ptr<QOffscreenSurface> fallback_surface;
+    std::unique_ptr<QRhi> rhi =
+        CreateRhi(backend, nullptr, vulkan_instance_, &fallback_surface);
+    if (!rhi) {
+      if (options_.skip_unavailable) {
+        qWarning("  %-16s = not available, skipped", RhiBackendName(backend));
+      } else {
+        ok = false;
+      }
+      continue;
+    }
+    ok = RunBackend(backend, rhi.get(), &suite, &runs) && ok;
+    ++measured;
+  }
+  suite.Log();
+  if (!measured) {
+    qCritical("No backend could be used");
+    return EXIT_FAILURE;
+  }
+  if (!ok) {
+    return EXIT_FAILURE;
+  }
+
+  if (options_.json_path.isEmpty()) {
+    return EXIT_SUCCESS;
+  }
+  const QJsonObject json{{"benchmark", "RhiTriangle.headless"},
+                         {"width", options_.size.width()},
+                         {"height", options_.size.height()},
+                         {"instances", options_.instances},
+                         {"runs", runs},
+                         {"bench", suite.ToJson()}};
+  QFile file(options_.json_path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Failed to write %s", qPrintable(options_.json_path));
+    return EXIT_FAILURE;
+  }
+  file.write(QJsonDocument(json).toJson());
+  return EXIT_SUCCESS;
+}
+
+bool RhiHeadlessBenchmark::RunBackend(RhiBackend backend,
+                                      QRhi* rhi,
+                                      bench::Suite* suite,
+                                      QJsonArray* runs) {
+  const char* name = RhiBackendName(backend);
+  const QByteArray device = rhi->driverInfo().deviceName;
+  const bool timestamps = rhi->isFeatureSupported(QRhi::Timestamps);
+  qInfo("  %-16s = %s%s", name, device.constData(),
+        timestamps ? "" : " (no timestamps)");
+
+  std::unique_ptr<QRhiTexture> texture(
+      rhi->newTexture(QRhiTexture::RGBA8, options_.size, 1,
+                      QRhiTexture::RenderTarget));
+  std::unique_ptr<QRhiRenderBuffer> depth_stencil(rhi->newRenderBuffer(
+      QRhiRenderBuffer::DepthStencil, options_.size, 1));
+  if (!texture->create() || !depth_stencil->create()) {
+    qWarning("Failed to create a %dx%d render target",
+             options_.size.width(), options_.size.height());
+    return false;
+  }
+  QRhiTextureRenderTargetDescription description{
+      QRhiColorAttachment(texture.get())};
+  description.setDepthStencilBuffer(depth_stencil.get());
+  std::unique_ptr<QRhiTextureRenderTarget> target(
+      rhi->newTextureRenderTarget(description));
+  std::unique_ptr<QRhiRenderPassDescriptor> render_pass(
+      target->newCompatibleRenderPassDescriptor());
+  target->setRenderPassDescriptor(render_pass.get());
+  target->create();
+
+  RhiTriangleScene scene;
+  scene.SetInstanceCount(options_.instances);
+  if (!scene.Init(rhi, render_pass.get(), 1)) {
+    scene.Release();
+    return false;
+  }
+  scene.Resize(options_.size);
+
+  QElapsedTimer timer;
+  timer.start();
+  QJsonObject run;
+  const bool ok = suite->Run(options_.bench, [&] {
+    qint64 wall_start = timer.nsecsElapsed();
+    qint64 record_ns{};
+    qint64 end_frame_ns{};
+    double gpu_seconds{};
+    const int total_frames = options_.warmup_frames + options_.frames;
+    for (int i = 0; i < total_frames; ++i) {
+      if (i == options_.warmup_frames) {
+        wall_start = timer.nsecsElapsed();
+        record_ns = 0;
+        end_frame_ns = 0;
+        gpu_seconds = 0;
+      }
+      TRACE_SCOPE("rhi", "HeadlessFrame");
+      QRhiCommandBuffer* cb{};
+      if (rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+        qWarning("%s: beginOffscreenFrame failed", name);
+        return false;
+      }
+      const qint64 start = timer.nsecsElapsed();
+      scene.Record(cb, target.get());
+      const qint64 recorded = timer.nsecsElapsed();
+      rhi->endOffscreenFrame();
+      end_frame_ns += timer.nsecsElapsed() - recorded;
+      record_ns += recorded - start;
+      // The frame has completed, so this is its own GPU time.
+      gpu_seconds += cb->lastCompletedGpuTime();
+    }
+    const double seconds = (timer.nsecsElapsed() - wall_start) / 1e9;
+    const int frames = qMax(options_.frames, 1);
+    const double fps = seconds > 0 ? options_.frames / seconds : 0;
+    const double record_us = record_ns / 1e3 / frames;
+    const double end_frame_us = end_frame_ns / 1e3 / frames;
+    const double gpu_us = timestamps ? gpu_seconds * 1e6 / frames : -1;
+    qInfo("  %s", name);
+    qInfo("    frames/s       = %.1f", fps);
+    qInfo("    cpu record us  = %.2f", record_us);
+    qInfo("    cpu end us     = %.2f", end_frame_us);
+    qInfo("    gpu frame us   = %.2f", gpu_us);
+    run = {{"backend", name},
+           {"device", QString::fromUtf8(device)},
+           {"frames", options_.frames},
+           {"fps", fps},
+           {"cpu_record_us", record_us},
+           {"cpu_end_frame_us", end_frame_us},
+           {"gpu_frame_us", gpu_us}};
+    suite->AddJson(name, run);
+    return true;
+  });
+  runs->append(run);
+  // Let the GPU finish with the resources before they go.
+  rhi->finish();
+  scene.Release();
+  return ok;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QVulkanInstance>
+
+#include "bench.h"
+#include "rhi_backend.h"
+
+// Renders RhiTriangleScene into a texture with offscreen QRhi frames on each
+// requested backend in turn. Offscreen frames are synchronous: endFrame()
+// submits and waits, so the CPU side is reported as the time to record the
+// frame and the time spent in endOffscreenFrame() (command translation for
+// OpenGL, submission plus the wait for Vulkan), next to the GPU time from
+// QRhi's timestamps.
+class RhiHeadlessBenchmark {
+ public:
+  struct Options {
+    std::vector<RhiBackend> backends{RhiBackend::kOpenGL,
+                                     RhiBackend::kVulkan};
+    // Warn about backends that cannot be created instead of failing, for
+    // `--backend all`. At least one must still run.
+    bool skip_unavailable{false};
+    int frames{1000};
+    int warmup_frames{60};
+    int instances{1};
+    QSize size{1024, 768};
+    // Whole runs of `frames` per backend, summarized in the JSON file.
+    bench::Options bench;
+    QString json_path;  // empty: log only
+  };
+
+  RhiHeadlessBenchmark(QVulkanInstance* vulkan_instance,
+                       const Options& options) noexcept
+      : vulkan_instance_(vulkan_instance), options_(options) {}
+
+  // Returns EXIT_SUCCESS, or EXIT_FAILURE when a backend failed, could not be
+  // created without skip_unavailable, or none ran at all.
+  int Run();
+
+ private:
+  // Runs the suite on `rhi` and appends its result to `runs`.
+  bool RunBackend(RhiBackend backend,
+                  QRhi* rhi,
+                  bench::Suite* suite,
+                  QJsonArray* runs);
+
+  QVulkanInstance* vulkan_instance_;
+  Options options_;
+};
@@ -0,0 +1,150 @@
+#include "rhi_scene.h"
+
+#include <cmath>
+#include <vector>
+
+#include <QtCore/QFile>
+#include <QtGui/QColor>
+#include <rhi/qshader.h>
+
+#include "tracing.h"
+
+namespace {
+// Same triangle as VkTriangle, Y up, front = CCW.
+constexpr float kVertexData[]{
+    // x    y     R     G     B
+    0.0f,  0.5f,  1.0f, 0.0f, 0.0f,  // 0
+    -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,  // 1
+    0.5f,  -0.5f, 0.0f, 0.0f, 1.0f   // 2
+};
+
+// std140: mat4 projection, float rotation, padded to 16 bytes.
+constexpr quint32 kUniformSize{80};
+
+QShader LoadShader(const QString& name) {
+  QFile file(name);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning("Failed to read shader %s", qPrintable(name));
+    return {};
+  }
+  return QShader::fromSerialized(file.readAll());
+}
+}  // namespace
+
+bool RhiTriangleScene::Init(QRhi* rhi,
+                            QRhiRenderPassDescriptor* render_pass,
+                            int sample_count) noexcept {
+  rhi_ = rhi;
+
+  // Lay the instances out on a grid filling [-1, 1] x [-1, 1]; a single one
+  // fills the view like VkTriangle's.
+  const int columns = int(std::ceil(std::sqrt(double(instance_count_))));
+  const float cell = instance_count_ > 1 ? 2.0f / columns : 1.0f;
+  std::vector<float> instances;
+  instances.reserve(size_t(instance_count_) * 4);
+  for (int i = 0; i < instance_count_; ++i) {
+    const bool grid = instance_count_ > 1;
+    instances.push_back(grid ? -1.0f + cell * (i % columns + 0.5f) : 0.0f);
+    instances.push_back(grid ? -1.0f + cell * (i / columns + 0.5f) : 0.0f);
+    instances.push_back(cell);
+    instances.push_back(i * 7.0f);
+  }
+  const auto instance_bytes = quint32(instances.size() * sizeof(float));
+
+  vertex_buffer_.reset(rhi->newBuffer(QRhiBuffer::Immutable,
+                                      QRhiBuffer::VertexBuffer,
+                                      sizeof(kVertexData)));
+  instance_buffer_.reset(rhi->newBuffer(
+      QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, instance_bytes));
+  uniform_buffer_.reset(rhi->newBuffer(
+      QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, kUniformSize));
+  if (!vertex_buffer_->create() || !instance_buffer_->create() ||
+      !uniform_buffer_->create()) {
+    qWarning("Failed to create buffers for %d instances", instance_count_);
+    return false;
+  }
+  initial_updates_ = rhi->nextResourceUpdateBatch();
+  initial_updates_->uploadStaticBuffer(vertex_buffer_.get(), kVertexData);
+  initial_updates_->uploadStaticBuffer(instance_buffer_.get(), 0,
+                                       instance_bytes, instances.data());
+
+  bindings_.reset(rhi->newShaderResourceBindings());
+  bindings_->setBindings({QRhiShaderResourceBinding::uniformBuffer(
+      0, QRhiShaderResourceBinding::VertexStage, uniform_buffer_.get())});
+  bindings_->create();
+
+  const QShader vertex_shader = LoadShader(":/res/triangle.vert.qsb");
+  const QShader fragment_shader = LoadShader(":/res/triangle.frag.qsb");
+  if (!vertex_shader.isValid() || !fragment_shader.isValid()) {
+    return false;
+  }
+  pipeline_.reset(rhi->newGraphicsPipeline());
+  pipeline_->setShaderStages({{QRhiShaderStage::Vertex, vertex_shader},
+                              {QRhiShaderStage::Fragment, fragment_shader}});
+  QRhiVertexInputLayout input_layout;
+  input_layout.setBindings(
+      {{5 * sizeof(float)},
+       {4 * sizeof(float), QRhiVertexInputBinding::PerInstance}});
+  input_layout.setAttributes(
+      {{0, 0, QRhiVertexInputAttribute::Float2, 0},
+       {0, 1, QRhiVertexInputAttribute::Float3, 2 * sizeof(float)},
+       {1, 2, QRhiVertexInputAttribute::Float4, 0}});
+  pipeline_->setVertexInputLayout(input_layout);
+  pipeline_->setSampleCount(sample_count);
+  pipeline_->setShaderResourceBindings(bindings_.get());
+  pipeline_->setRenderPassDescriptor(render_pass);
+  if (!pipeline_->create()) {
+    qWarning("Failed to create the graphics pipeline");
+    return false;
+  }
+  return true;
+}
+
+void RhiTriangleScene::Release() noexcept {
+  if (initial_updates_) {
+    initial_updates_->release();
+    initial_updates_ = nullptr;
+  }
+  pipeline_.reset();
+  bindings_.reset();
+  uniform_buffer_.reset();
+  instance_buffer_.reset();
+  vertex_buffer_.reset();
+  rhi_ = nullptr;
+}
+
+void RhiTriangleScene::Resize(const QSize& size) noexcept {
+  size_ = size;
+  projection_ = rhi_->clipSpaceCorrMatrix();
+  projection_.perspective(45.0f, size.width() / float(size.height()), 0.01f,
+                          100.0f);
+  projection_.translate(0, 0, -4);
+}
+
+void RhiTriangleScene::Record(QRhiCommandBuffer* cb,
+                              QRhiRenderTarget* target) noexcept {
+  TRACE_SCOPE("rhi", "Record");
+  QRhiResourceUpdateBatch* updates = initial_updates_;
+  initial_updates_ = nullptr;
+  if (!updates) {
+    updates = rhi_->nextResourceUpdateBatch();
+  }
+  updates->updateDynamicBuffer(uniform_buffer_.get(), 0, 64,
+                               projection_.constData());
+  updates->updateDynamicBuffer(uniform_buffer_.get(), 64, sizeof(float),
+                               &rotation_);
+
+  cb->beginPass(target, QColor::fromRgbF(0.0f, 0.25f, 0.0f, 1.0f),
+                {1.0f, 0}, updates);
+  cb->setGraphicsPipeline(pipeline_.get());
+  cb->setViewport({0, 0, float(size_.width()), float(size_.height())});
+  cb->setShaderResources();
+  const QRhiCommandBuffer::VertexInput inputs[]{{vertex_buffer_.get(), 0},
+                                                {instance_buffer_.get(), 0}};
+  cb->setVertexInput(0, 2, inputs);
+  cb->draw(3, quint32(instance_count_));
+  cb->endPass();
+
+  // Not exactly a real animation system, just advance on every frame for now.
+  rotation_ += 1.0f;
+}
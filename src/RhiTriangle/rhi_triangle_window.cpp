@@ -0,0 +1,148 @@
+#include "rhi_triangle_window.h"
+
+#include <QtGui/QPlatformSurfaceEvent>
+
+#include "tracing.h"
+
+RhiTriangleWindow::RhiTriangleWindow(RhiBackend backend,
+                                     QVulkanInstance* vulkan_instance,
+                                     int instance_count) noexcept
+    : backend_(backend) {
+  setSurfaceType(RhiSurfaceType(backend));
+  if (backend == RhiBackend::kVulkan) {
+    setVulkanInstance(vulkan_instance);
+  }
+  scene_.SetInstanceCount(instance_count);
+}
+
+RhiTriangleWindow::~RhiTriangleWindow() {
+  ReleaseSwapChain();
+  scene_.Release();
+  render_pass_.reset();
+  depth_stencil_.reset();
+  swap_chain_.reset();
+  rhi_.reset();
+}
+
+void RhiTriangleWindow::exposeEvent(QExposeEvent*) {
+  if (isExposed() && !initialized_) {
+    initialized_ = true;
+    if (!Init()) {
+      qFatal("Failed to initialize %s", RhiBackendName(backend_));
+    }
+    ResizeSwapChain();
+  }
+
+  // Exposed with a different size: resize before the next frame, not in
+  // resizeEvent(), which may come before the surface is ready.
+  const QSize surface_size = has_swap_chain_ ? swap_chain_->surfacePixelSize()
+                                             : QSize();
+  if (isExposed() && has_swap_chain_ &&
+      swap_chain_->currentPixelSize() != surface_size) {
+    ResizeSwapChain();
+  }
+  if (isExposed() && has_swap_chain_) {
+    Render();
+  }
+}
+
+bool RhiTriangleWindow::event(QEvent* event) {
+  switch (event->type()) {
+    case QEvent::UpdateRequest:
+      Render();
+      break;
+    case QEvent::PlatformSurface:
+      // The swap chain must go before the surface it presents to.
+      if (static_cast<QPlatformSurfaceEvent*>(event)->surfaceEventType() ==
+          QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed) {
+        ReleaseSwapChain();
+      }
+      break;
+    default:
+      break;
+  }
+  return QWindow::event(event);
+}
+
+bool RhiTriangleWindow::Init() {
+  rhi_ = CreateRhi(backend_, this, vulkanInstance(), &fallback_surface_);
+  if (!rhi_) {
+    return false;
+  }
+  qInfo("RhiTriangle on %s: %s", rhi_->backendName(),
+        rhi_->driverInfo().deviceName.constData());
+
+  swap_chain_.reset(rhi_->newSwapChain());
+  depth_stencil_.reset(rhi_->newRenderBuffer(
+      QRhiRenderBuffer::DepthStencil, QSize(), 1,
+      QRhiRenderBuffer::UsedWithSwapChainOnly));
+  swap_chain_->setWindow(this);
+  swap_chain_->setDepthStencil(depth_stencil_.get());
+  render_pass_.reset(swap_chain_->newCompatibleRenderPassDescriptor());
+  swap_chain_->setRenderPassDescriptor(render_pass_.get());
+
+  report_timer_.start();
+  return scene_.Init(rhi_.get(), render_pass_.get(), 1);
+}
+
+void RhiTriangleWindow::ResizeSwapChain() {
+  has_swap_chain_ = swap_chain_->createOrResize();
+  if (has_swap_chain_) {
+    scene_.Resize(swap_chain_->currentPixelSize());
+  }
+}
+
+void RhiTriangleWindow::ReleaseSwapChain() {
+  if (has_swap_chain_) {
+    has_swap_chain_ = false;
+    swap_chain_->destroy();
+  }
+}
+
+void RhiTriangleWindow::Render() {
+  if (!has_swap_chain_) {
+    return;
+  }
+  TRACE_SCOPE("rhi", "Render");
+
+  QRhi::FrameOpResult result = rhi_->beginFrame(swap_chain_.get());
+  if (result == QRhi::FrameOpSwapChainOutOfDate) {
+    ResizeSwapChain();
+    if (!has_swap_chain_) {
+      return;
+    }
+    result = rhi_->beginFrame(swap_chain_.get());
+  }
+  if (result != QRhi::FrameOpSuccess) {
+    requestUpdate();
+    return;
+  }
+
+  QElapsedTimer record_timer;
+  record_timer.start();
+  QRhiCommandBuffer* cb = swap_chain_->currentFrameCommandBuffer();
+  scene_.Record(cb, swap_chain_->currentFrameRenderTarget());
+  record_ns_ += record_timer.nsecsElapsed();
+  // Of an earlier frame that has completed by now, 0 while there is none.
+  const double gpu_seconds = cb->lastCompletedGpuTime();
+  if (gpu_seconds > 0) {
+    gpu_seconds_ += gpu_seconds;
+    ++gpu_frames_;
+  }
+  rhi_->endFrame(swap_chain_.get());
+  ++frames_;
+
+  if (report_timer_.elapsed() >= 2000) {
+    const double seconds = report_timer_.nsecsElapsed() / 1e9;
+    qInfo("%s: %.1f frames/s, cpu record %.3f ms, gpu %.3f ms",
+          RhiBackendName(backend_), frames_ / seconds,
+          record_ns_ / 1e6 / frames_,
+          gpu_frames_ ? gpu_seconds_ * 1e3 / gpu_frames_ : -1.0);
+    report_timer_.restart();
+    frames_ = 0;
+    record_ns_ = 0;
+    gpu_seconds_ = 0;
+    gpu_frames_ = 0;
+  }
+  requestUpdate();
+}
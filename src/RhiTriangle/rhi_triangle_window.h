@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QWindow>
+
+#include "rhi_backend.h"
+#include "rhi_scene.h"
+
+// Presents RhiTriangleScene through a QRhiSwapChain on the chosen backend
+// and logs frame rate, CPU recording and GPU time every 2 seconds.
+class RhiTriangleWindow : public QWindow {
+ public:
+  RhiTriangleWindow(RhiBackend backend,
+                    QVulkanInstance* vulkan_instance,
+                    int instance_count) noexcept;
+  ~RhiTriangleWindow();
+
+ protected:
+  void exposeEvent(QExposeEvent* event) override;
+  bool event(QEvent* event) override;
+
+ private:
+  bool Init();
+  void ResizeSwapChain();
+  void ReleaseSwapChain();
+  void Render();
+
+  RhiBackend backend_;
+  std::unique_ptr<QOffscreenSurface> fallback_surface_;
+  std::unique_ptr<QRhi> rhi_;
+  std::unique_ptr<QRhiSwapChain> swap_chain_;
+  std::unique_ptr<QRhiRenderBuffer> depth_stencil_;
+  std::unique_ptr<QRhiRenderPassDescriptor> render_pass_;
+  RhiTriangleScene scene_;
+  bool initialized_{false};
+  bool has_swap_chain_{false};
+
+  QElapsedTimer report_timer_;
+  int frames_{};
+  qint64 record_ns_{};
+  double gpu_seconds_{};
+  int gpu_frames_{};
+};
@@ -0,0 +1,335 @@
+#include "trace_writer.h"
+
+#if TRACING_ENABLED
+
+#include <cstring>
+#include <set>
+#include <utility>
+
+namespace tracing {
+namespace {
+
+// ---- Chrome JSON ---------------------------------------------------------
+
+void AppendString(QByteArray* out, const char* s) {
+  out->append('"');
+  for (; *s; ++s) {
+    const char c = *s;
+    if (c == '"' || c == '\\') {
+      out->append('\\').append(c);
+    } else if (uchar(c) < 0x20) {
+      out->append("\\u00").append(QByteArray::number(uchar(c), 16)
+                                      .rightJustified(2, '0'));
+    } else {
+      out->append(c);
+    }
+  }
+  out->append('"');
+}
+
+// Microseconds with nanosecond precision, as the format wants.
+void AppendTimestamp(QByteArray* out, int64_t ns) {
+  out->append(QByteArray::number(qint64(ns / 1000)))
+      .append('.')
+      .append(QByteArray::number(qint64(ns % 1000)).rightJustified(3, '0'));
+}
+
+const char* Phase(EventType type) {
+  switch (type) {
+    case EventType::kBegin:
+      return "B";
+    case EventType::kEnd:
+      return "E";
+    case EventType::kInstant:
+      return "i";
+    case EventType::kCounter:
+      return "C";
+    case EventType::kFlowBegin:
+      return "s";
+    case EventType::kFlowStep:
+      return "t";
+    case EventType::kFlowEnd:
+      return "f";
+  }
+  return "i";
+}
+
+// ---- Perfetto protobuf ---------------------------------------------------
+
+// Field numbers from perfetto/protos/perfetto/trace/.
+enum : uint32_t {
+  kTracePacket = 1,  // Trace
+
+  kPacketTimestamp = 8,  // TracePacket
+  kPacketSequenceId = 10,
+  kPacketTrackEvent = 11,
+  kPacketSequenceFlags = 13,
+  kPacketTrackDescriptor = 60,
+
+  kEventType = 9,  // TrackEvent
+  kEventTrackUuid = 11,
+  kEventCategories = 22,
+  kEventName = 23,
+  kEventDoubleCounterValue = 44,
+  kEventFlowIds = 47,
+  kEventTerminatingFlowIds = 48,
+
+  kTrackUuid = 1,  // TrackDescriptor
+  kTrackName = 2,
+  kTrackProcess = 3,
+  kTrackThread = 4,
+  kTrackParentUuid = 5,
+  kTrackCounter = 8,
+
+  kProcessPid = 1,  // ProcessDescriptor
+  kProcessName = 6,
+
+  kThreadPid = 1,  // ThreadDescriptor
+  kThreadTid = 2,
+  kThreadName = 5,
+};
+
+enum : uint32_t {
+  kTypeSliceBegin = 1,  // TrackEvent.Type
+  kTypeSliceEnd = 2,
+  kTypeInstant = 3,
+  kTypeCounter = 4,
+};
+
+constexpr uint32_t kSequenceId{1};
+constexpr uint32_t kIncrementalStateCleared{1};
+
+enum WireType : uint32_t { kVarint = 0, kFixed64 = 1, kLengthDelimited = 2 };
+
+void Varint(QByteArray* out, uint64_t v) {
+  while (v >= 0x80) {
+    out->append(char(v | 0x80));
+    v >>= 7;
+  }
+  out->append(char(v));
+}
+
+void Tag(QByteArray* out, uint32_t field, WireType type) {
+  Varint(out, (uint64_t(field) << 3) | type);
+}
+
+void VarintField(QByteArray* out, uint32_t field, uint64_t v) {
+  Tag(out, field, kVarint);
+  Varint(out, v);
+}
+
+void Fixed64Field(QByteArray* out, uint32_t field, uint64_t v) {
+  Tag(out, field, kFixed64);
+  for (int i = 0; i < 8; ++i) {
+    out->append(char(v >> (8 * i)));
+  }
+}
+
+void DoubleField(QByteArray* out, uint32_t field, double v) {
+  uint64_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  Fixed64Field(out, field, bits);
+}
+
+void BytesField(QByteArray* out, uint32_t field, const QByteArray& bytes) {
+  Tag(out, field, kLengthDelimited);
+  Varint(out, uint64_t(bytes.size()));
+  out->append(bytes);
+}
+
+// Wraps `body` into a TracePacket and appends it to the Trace.
+void Packet(QByteArray* out, const QByteArray& body) {
+  BytesField(out, kTracePacket, body);
+}
+
+uint64_t ProcessUuid(qint64 pid) {
+  return uint64_t(pid) << 16;
+}
+
+uint64_t ThreadUuid(qint64 pid, int tid) {
+  return ProcessUuid(pid) | uint64_t(tid);
+}
+
+// Counter tracks are keyed by name, which is a string literal, but the same
+// literal may have several addresses across translation units.
+uint64_t CounterUuid(const char* name) {
+  uint64_t h = 14695981039346656037ULL;  // FNV-1a
+  for (; *name; ++name) {
+    h = (h ^ uchar(*name)) * 1099511628211ULL;
+  }
+  return h | (1ULL << 63);
+}
+
+}  // namespace
+
+QByteArray ToChromeJson(const ProcessTrace& trace) {
+  QByteArray out;
+  const QByteArray pid = QByteArray::number(trace.pid);
+  out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  out.append("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":")
+      .append(pid)
+      .append(",\"tid\":0,\"args\":{\"name\":");
+  AppendString(&out, trace.name.constData());
+  out.append("}}");
+
+  for (const ThreadTrace& thread : trace.threads) {
+    const QByteArray tid = QByteArray::number(thread.tid);
+    out.append(",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":")
+        .append(pid)
+        .append(",\"tid\":")
+        .append(tid)
+        .append(",\"args\":{\"name\":");
+    AppendString(&out, thread.name.constData());
+    out.append("}}");
+
+    for (const Event& event : thread.events) {
+      out.append(",\n{\"ph\":\"")
+          .append(Phase(event.type))
+          .append("\",\"cat\":");
+      AppendString(&out, event.category);
+      out.append(",\"name\":");
+      AppendString(&out, event.name);
+      out.append(",\"ts\":");
+      AppendTimestamp(&out, event.timestamp_ns);
+      out.append(",\"pid\":").append(pid).append(",\"tid\":").append(tid);
+      switch (event.type) {
+        case EventType::kInstant:
+          out.append(",\"s\":\"t\"");
+          break;
+        case EventType::kCounter:
+          out.append(",\"args\":{\"value\":")
+              .append(QByteArray::number(event.value, 'g', 17))
+              .append('}');
+          break;
+        case EventType::kFlowBegin:
+        case EventType::kFlowStep:
+        case EventType::kFlowEnd:
+          // Binds to the enclosing span rather than the next one.
+          out.append(",\"bp\":\"e\",\"id\":")
+              .append(QByteArray::number(quint64(event.id)));
+          break;
+        case EventType::kBegin:
+        case EventType::kEnd:
+          break;
+      }
+      out.append('}');
+    }
+  }
+  out.append("\n]}\n");
+  return out;
+}
+
+QByteArray ToPerfetto(const ProcessTrace& trace) {
+  QByteArray out;
+  bool first_packet = true;
+  auto sequence = [&first_packet](QByteArray* packet) {
+    VarintField(packet, kPacketSequenceId, kSequenceId);
+    if (first_packet) {
+      first_packet = false;
+      VarintField(packet, kPacketSequenceFlags, kIncrementalStateCleared);
+    }
+  };
+
+  {
+    QByteArray process;
+    VarintField(&process, kProcessPid, uint64_t(trace.pid));
+    BytesField(&process, kProcessName, trace.name);
+    QByteArray track;
+    VarintField(&track, kTrackUuid, ProcessUuid(trace.pid));
+    BytesField(&track, kTrackProcess, process);
+    QByteArray packet;
+    sequence(&packet);
+    BytesField(&packet, kPacketTrackDescriptor, track);
+    Packet(&out, packet);
+  }
+
+  std::set<std::pair<uint64_t, QByteArray>> counters;
+  for (const ThreadTrace& thread : trace.threads) {
+    QByteArray descriptor;
+    VarintField(&descriptor, kThreadPid, uint64_t(trace.pid));
+    VarintField(&descriptor, kThreadTid, uint64_t(thread.tid));
+    BytesField(&descriptor, kThreadName, thread.name);
+    QByteArray track;
+    VarintField(&track, kTrackUuid, ThreadUuid(trace.pid, thread.tid));
+    BytesField(&track, kTrackThread, descriptor);
+    QByteArray packet;
+    sequence(&packet);
+    BytesField(&packet, kPacketTrackDescriptor, track);
+    Packet(&out, packet);
+
+    for (const Event& event : thread.events) {
+      if (event.type == EventType::kCounter) {
+        counters.emplace(CounterUuid(event.name), QByteArray(event.name));
+      }
+    }
+  }
+
+  for (const auto& [uuid, name] : counters) {
+    QByteArray track;
+    VarintField(&track, kTrackUuid, uuid);
+    BytesField(&track, kTrackName, name);
+    VarintField(&track, kTrackParentUuid, ProcessUuid(trace.pid));
+    BytesField(&track, kTrackCounter, {});
+    QByteArray packet;
+    sequence(&packet);
+    BytesField(&packet, kPacketTrackDescriptor, track);
+    Packet(&out, packet);
+  }
+
+  for (const ThreadTrace& thread : trace.threads) {
+    const uint64_t thread_uuid = ThreadUuid(trace.pid, thread.tid);
+    for (const Event& event : thread.events) {
+      QByteArray track_event;
+      switch (event.type) {
+        case EventType::kBegin:
+          VarintField(&track_event, kEventType, kTypeSliceBegin);
+          break;
+        case EventType::kEnd:
+          VarintField(&track_event, kEventType, kTypeSliceEnd);
+          break;
+        case EventType::kCounter:
+          VarintField(&track_event, kEventType, kTypeCounter);
+          break;
+        case EventType::kInstant:
+        case EventType::kFlowBegin:
+        case EventType::kFlowStep:
+        case EventType::kFlowEnd:
+          // Flows hang off an instant on the thread that recorded them.
+          VarintField(&track_event, kEventType, kTypeInstant);
+          break;
+      }
+      const bool counter = event.type == EventType::kCounter;
+      VarintField(&track_event, kEventTrackUuid,
+                  counter ? CounterUuid(event.name) : thread_uuid);
+      if (!counter) {
+        BytesField(&track_event, kEventCategories,
+                   QByteArray::fromRawData(event.category,
+                                           int(std::strlen(event.category))));
+      }
+      if (event.type != EventType::kEnd && !counter) {
+        BytesField(&track_event, kEventName,
+                   QByteArray::fromRawData(event.name,
+                                           int(std::strlen(event.name))));
+      }
+      if (counter) {
+        DoubleField(&track_event, kEventDoubleCounterValue, event.value);
+      } else if (event.type == EventType::kFlowEnd) {
+        Fixed64Field(&track_event, kEventTerminatingFlowIds, event.id);
+      } else if (event.type == EventType::kFlowBegin ||
+                 event.type == EventType::kFlowStep) {
+        Fixed64Field(&track_event, kEventFlowIds, event.id);
+      }
+
+      QByteArray packet;
+      VarintField(&packet, kPacketTimestamp, uint64_t(event.timestamp_ns));
+      sequence(&packet);
+      BytesField(&packet, kPacketTrackEvent, track_event);
+      Packet(&out, packet);
+    }
+  }
+  return out;
+}
+
+}  // namespace tracing
+
+#endif  // TRACING_ENABLED
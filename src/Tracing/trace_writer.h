@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include <QtCore/QByteArray>
+
+#include "tracing.h"
+
+namespace tracing {
+
+struct ThreadTrace {
+  int tid{};
+  QByteArray name;
+  std::vector<Event> events;  // in recording order
+};
+
+struct ProcessTrace {
+  qint64 pid{};
+  QByteArray name;
+  std::vector<ThreadTrace> threads;
+};
+
+// Chrome trace event format, the JSON object flavor.
+QByteArray ToChromeJson(const ProcessTrace& trace);
+// Perfetto TracePacket stream with TrackEvents, no interning.
+QByteArray ToPerfetto(const ProcessTrace& trace);
+
+}  // namespace tracing
@@ -0,0 +1,295 @@
+#include "tracing.h"
+
+#if TRACING_ENABLED
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QSaveFile>
+
+#include "trace_writer.h"
+
+#if defined(Q_OS_UNIX)
+#include <csignal>
+#include <thread>
+
+#include <unistd.h>
+#endif
+
+namespace tracing {
+namespace internal {
+std::atomic<bool> g_enabled{false};
+}  // namespace internal
+
+namespace {
+
+// An Event as relaxed atomic words: Snapshot() may copy a slot while its
+// thread overwrites it, which would be a data race on a plain Event. The
+// copy may come out torn, Snapshot() finds out from head and drops it.
+static_assert(std::is_trivially_copyable_v<Event>);
+static_assert(sizeof(Event) % sizeof(uint64_t) == 0);
+using EventSlot =
+    std::array<std::atomic<uint64_t>, sizeof(Event) / sizeof(uint64_t)>;
+
+inline void StoreEvent(EventSlot* slot, const Event& event) noexcept {
+  uint64_t words[std::tuple_size_v<EventSlot>];
+  std::memcpy(words, &event, sizeof(Event));
+  for (size_t i = 0; i < slot->size(); ++i) {
+    (*slot)[i].store(words[i], std::memory_order_relaxed);
+  }
+}
+
+inline Event LoadEvent(const EventSlot& slot) noexcept {
+  uint64_t words[std::tuple_size_v<EventSlot>];
+  for (size_t i = 0; i < slot.size(); ++i) {
+    words[i] = slot[i].load(std::memory_order_relaxed);
+  }
+  Event event;
+  std::memcpy(&event, words, sizeof(Event));
+  return event;
+}
+
+// Single producer, the owning thread. Flush() copies it from another thread
+// without stopping the producer, see Snapshot().
+struct ThreadBuffer {
+  ThreadBuffer(int tid, uint64_t capacity)
+      : tid(tid), mask(capacity - 1), events(new EventSlot[capacity]) {}
+
+  const int tid;
+  const uint64_t mask;
+  const std::unique_ptr<EventSlot[]> events;
+  std::atomic<uint64_t> head{0};  // events recorded so far
+  QByteArray name;                // guarded by g_mutex
+};
+
+// Guards everything below but the buffer contents.
+std::mutex g_mutex;
+// Never shrinks: threads that ended still have events to write.
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+uint64_t g_capacity{1 << 16};
+QString g_path;
+QByteArray g_process_name;
+bool g_exit_handler_installed{false};
+
+thread_local ThreadBuffer* t_buffer{};
+
+int64_t Now() noexcept {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+ThreadBuffer* RegisterThread() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  // Perfetto treats tid 0 as the idle task, start at 1.
+  const int tid = int(g_buffers.size()) + 1;
+  g_buffers.push_back(std::make_unique<ThreadBuffer>(tid, g_capacity));
+  t_buffer = g_buffers.back().get();
+  t_buffer->name = "thread " + QByteArray::number(tid);
+  return t_buffer;
+}
+
+inline void Append(const Event& event) noexcept {
+  ThreadBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+  const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+  // Pairs with the fence in Snapshot(): a reader that sees any word of this
+  // event also sees head, so it knows the slot is being overwritten.
+  std::atomic_thread_fence(std::memory_order_release);
+  StoreEvent(&buffer->events[head & buffer->mask], event);
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+// Copies the latest events of `buffer`. Its thread keeps recording
+// meanwhile and may wrap around onto the oldest slots being copied; those
+// are dropped afterwards instead of locking the hot path, together with the
+// slot that may be half written right now.
+ThreadTrace Snapshot(const ThreadBuffer& buffer) {
+  const uint64_t capacity = buffer.mask + 1;
+  const uint64_t head = buffer.head.load(std::memory_order_acquire);
+  const uint64_t first = head > capacity ? head - capacity : 0;
+
+  ThreadTrace thread;
+  thread.tid = buffer.tid;
+  thread.name = buffer.name;
+  thread.events.reserve(head - first);
+  for (uint64_t i = first; i < head; ++i) {
+    thread.events.push_back(LoadEvent(buffer.events[i & buffer.mask]));
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  // + 1: the event being appended right now.
+  const uint64_t head_after = buffer.head.load(std::memory_order_relaxed) + 1;
+  const uint64_t overwritten =
+      head_after > capacity ? head_after - capacity : 0;
+  if (overwritten > first) {
+    const auto count = std::min<uint64_t>(overwritten - first,
+                                          thread.events.size());
+    thread.events.erase(thread.events.begin(),
+                        thread.events.begin() + ptrdiff_t(count));
+  }
+  return thread;
+}
+
+#if defined(Q_OS_UNIX)
+// SIGUSR1 asks for a flush. Writing the file is not async-signal-safe, so the
+// handler only wakes up a thread through a pipe.
+int g_signal_pipe[2]{-1, -1};
+std::thread g_signal_thread;
+
+void OnSignal(int) {
+  const char byte{};
+  [[maybe_unused]] const ssize_t written = write(g_signal_pipe[1], &byte, 1);
+}
+
+void InstallSignalHandler() {
+  if (pipe(g_signal_pipe) != 0) {
+    qWarning("Tracing: no pipe, SIGUSR1 will not flush");
+    return;
+  }
+  g_signal_thread = std::thread([] {
+    char byte;
+    while (read(g_signal_pipe[0], &byte, 1) == 1) {
+      Flush();
+    }
+  });
+  std::signal(SIGUSR1, OnSignal);
+}
+
+void RemoveSignalHandler() {
+  if (g_signal_pipe[1] < 0) {
+    return;
+  }
+  std::signal(SIGUSR1, SIG_DFL);
+  close(g_signal_pipe[1]);  // read() returns 0 and the thread ends
+  g_signal_thread.join();
+  close(g_signal_pipe[0]);
+  g_signal_pipe[0] = g_signal_pipe[1] = -1;
+}
+#endif
+
+}  // namespace
+
+namespace internal {
+
+void Record(EventType type, const char* category, const char* name) noexcept {
+  Event event;
+  event.timestamp_ns = Now();
+  event.category = category;
+  event.name = name;
+  event.id = 0;
+  event.type = type;
+  Append(event);
+}
+
+void RecordValue(const char* category,
+                 const char* name,
+                 double value) noexcept {
+  Event event;
+  event.timestamp_ns = Now();
+  event.category = category;
+  event.name = name;
+  event.value = value;
+  event.type = EventType::kCounter;
+  Append(event);
+}
+
+void RecordFlow(EventType type,
+                const char* category,
+                const char* name,
+                uint64_t id) noexcept {
+  Event event;
+  event.timestamp_ns = Now();
+  event.category = category;
+  event.name = name;
+  event.id = id;
+  event.type = type;
+  Append(event);
+}
+
+}  // namespace internal
+
+bool Start(const QString& path, int events_per_thread) {
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (internal::g_enabled.load()) {
+      qWarning("Tracing is already started");
+      return false;
+    }
+    g_path = path;
+    // Power of two, so the ring index is a mask.
+    g_capacity = 2;
+    while (g_capacity < uint64_t(events_per_thread)) {
+      g_capacity <<= 1;
+    }
+    g_process_name = QCoreApplication::applicationName().toUtf8();
+    if (!g_exit_handler_installed) {
+      g_exit_handler_installed = true;
+      std::atexit(Stop);
+    }
+  }
+
+#if defined(Q_OS_UNIX)
+  InstallSignalHandler();
+#endif
+  SetThreadName("main");
+  internal::g_enabled.store(true);
+  qInfo("Tracing to %s", qPrintable(path));
+  return true;
+}
+
+bool StartFromEnvironment() {
+  const QString path = qEnvironmentVariable("TRACE_FILE");
+  return !path.isEmpty() && Start(path);
+}
+
+bool Flush() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (g_path.isEmpty()) {
+    return false;
+  }
+
+  ProcessTrace trace;
+  trace.pid = QCoreApplication::applicationPid();
+  trace.name = g_process_name;
+  for (const std::unique_ptr<ThreadBuffer>& buffer : g_buffers) {
+    trace.threads.push_back(Snapshot(*buffer));
+  }
+
+  const bool perfetto = g_path.endsWith(QLatin1String(".pftrace")) ||
+                        g_path.endsWith(QLatin1String(".perfetto-trace"));
+  QSaveFile file(g_path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning("Failed to write %s", qPrintable(g_path));
+    return false;
+  }
+  file.write(perfetto ? ToPerfetto(trace) : ToChromeJson(trace));
+  return file.commit();
+}
+
+void Stop() {
+  if (!internal::g_enabled.exchange(false)) {
+    return;
+  }
+#if defined(Q_OS_UNIX)
+  RemoveSignalHandler();
+#endif
+  Flush();
+}
+
+void SetThreadName(const char* name) {
+  ThreadBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+  std::lock_guard<std::mutex> lock(g_mutex);
+  buffer->name = name;
+}
+
+}  // namespace tracing
+
+#endif  // TRACING_ENABLED
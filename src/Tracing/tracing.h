@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <QtCore/QString>
+
+// Scoped spans, counters and flow events for all applications under src/.
+//
+// Events are appended to a ring buffer owned by the recording thread, so
+// recording takes no lock: a clock read and a 40 byte store, a few tens of
+// nanoseconds. While tracing is not started every macro is one relaxed load
+// and a branch. Configured with -DTRACING=OFF, the macros expand to nothing
+// and the library is empty.
+//
+// Each buffer keeps the latest events of its thread. They are written on
+// Stop(), at exit, and, on POSIX, whenever the process gets SIGUSR1:
+//   TRACE_FILE=/tmp/vk.json VkTriangle          # Chrome trace JSON
+//   TRACE_FILE=/tmp/vk.pftrace VkTriangle       # Perfetto protobuf
+//   kill -USR1 <pid>                            # snapshot while running
+// Both open in https://ui.perfetto.dev; the JSON also in chrome://tracing.
+//
+// Categories and names are stored by pointer and must be string literals.
+
+#ifndef TRACING_ENABLED
+#define TRACING_ENABLED 1
+#endif
+
+namespace tracing {
+
+enum class EventType : uint8_t {
+  kBegin,
+  kEnd,
+  kInstant,
+  kCounter,
+  kFlowBegin,
+  kFlowStep,
+  kFlowEnd,
+};
+
+struct Event {
+  int64_t timestamp_ns;
+  const char* category;
+  const char* name;
+  union {
+    double value;  // kCounter
+    uint64_t id;   // flow events
+  };
+  EventType type;
+};
+
+#if TRACING_ENABLED
+
+namespace internal {
+extern std::atomic<bool> g_enabled;
+void Record(EventType type, const char* category, const char* name) noexcept;
+void RecordValue(const char* category, const char* name, double value) noexcept;
+void RecordFlow(EventType type,
+                const char* category,
+                const char* name,
+                uint64_t id) noexcept;
+}  // namespace internal
+
+inline bool Enabled() noexcept {
+  return internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts recording into per-thread buffers of `events_per_thread` events
+// (rounded up to a power of two). The format follows the extension of
+// `path`: .pftrace or .perfetto-trace for Perfetto, anything else JSON.
+bool Start(const QString& path, int events_per_thread = 1 << 16);
+// Start() with the path in the TRACE_FILE environment variable, if set.
+bool StartFromEnvironment();
+// Writes everything recorded so far; recording goes on.
+bool Flush();
+// Flushes and stops recording.
+void Stop();
+
+// Names the calling thread in the trace; the default is "thread <n>".
+void SetThreadName(const char* name);
+
+// Begin and end event on the current thread, nested spans nest in the UI.
+class Scope {
+ public:
+  Scope(const char* category, const char* name) noexcept
+      : category_(category), name_(name), active_(Enabled()) {
+    if (active_) {
+      internal::Record(EventType::kBegin, category_, name_);
+    }
+  }
+  ~Scope() {
+    if (active_) {
+      internal::Record(EventType::kEnd, category_, name_);
+    }
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  const char* category_;
+  const char* name_;
+  bool active_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(category, name) \
+  ::tracing::Scope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define TRACE_INSTANT(category, name)                                    \
+  do {                                                                   \
+    if (::tracing::Enabled())                                            \
+      ::tracing::internal::Record(::tracing::EventType::kInstant,        \
+                                  category, name);                       \
+  } while (0)
+#define TRACE_COUNTER(category, name, value)                              \
+  do {                                                                    \
+    if (::tracing::Enabled())                                             \
+      ::tracing::internal::RecordValue(category, name, double(value));    \
+  } while (0)
+// An arrow from the span enclosing BEGIN through any STEPs to the span
+// enclosing END, possibly on other threads. `id` identifies the flow.
+#define TRACE_FLOW(type, category, name, id)                              \
+  do {                                                                    \
+    if (::tracing::Enabled())                                             \
+      ::tracing::internal::RecordFlow(type, category, name, uint64_t(id)); \
+  } while (0)
+#define TRACE_FLOW_BEGIN(category, name, id) \
+  TRACE_FLOW(::tracing::EventType::kFlowBegin, category, name, id)
+#define TRACE_FLOW_STEP(category, name, id) \
+  TRACE_FLOW(::tracing::EventType::kFlowStep, category, name, id)
+#define TRACE_FLOW_END(category, name, id) \
+  TRACE_FLOW(::tracing::EventType::kFlowEnd, category, name, id)
+
+#else  // TRACING_ENABLED
+
+inline bool Enabled() noexcept {
+  return false;
+}
+inline bool Start(const QString&, int = 0) {
+  return false;
+}
+inline bool StartFromEnvironment() {
+  return false;
+}
+inline bool Flush() {
+  return false;
+}
+inline void Stop() {}
+inline void SetThreadName(const char*) {}
+
+#define TRACE_SCOPE(category, name) static_cast<void>(0)
+#define TRACE_INSTANT(category, name) static_cast<void>(0)
+#define TRACE_COUNTER(category, name, value) static_cast<void>(0)
+#define TRACE_FLOW_BEGIN(category, name, id) static_cast<void>(0)
+#define TRACE_FLOW_STEP(category, name, id) static_cast<void>(0)
+#define TRACE_FLOW_END(category, name, id) static_cast<void>(0)
+
+#endif  // TRACING_ENABLED
+
+}  // namespace tracing
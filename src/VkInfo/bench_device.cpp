@@ -0,0 +1,277 @@
+#include "bench_device.h"
+
+#include <cstring>
+#include <vector>
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QVersionNumber>
+
+static Q_LOGGING_CATEGORY(lcBench, "VkInfo.bench")
+
+BenchDevice::BenchDevice(QVulkanInstance* instance,
+                         VkPhysicalDevice physical_device) noexcept
+    : instance_(instance), physical_device_(physical_device) {}
+
+BenchDevice::~BenchDevice() {
+  if (!device_) {
+    return;
+  }
+  functions_->vkDeviceWaitIdle(device_);
+  if (query_pool_) {
+    functions_->vkDestroyQueryPool(device_, query_pool_, nullptr);
+  }
+  if (fence_) {
+    functions_->vkDestroyFence(device_, fence_, nullptr);
+  }
+  if (command_pool_) {
+    functions_->vkDestroyCommandPool(device_, command_pool_, nullptr);
+  }
+  functions_->vkDestroyDevice(device_, nullptr);
+  instance_->resetDeviceFunctions(device_);
+}
+
+bool BenchDevice::Create() noexcept {
+  QVulkanFunctions* f = instance_->functions();
+  f->vkGetPhysicalDeviceProperties(physical_device_, &properties_);
+  f->vkGetPhysicalDeviceMemoryProperties(physical_device_,
+                                         &memory_properties_);
+
+  // Prefer a queue that can time its work; every compute queue can also
+  // copy.
+  uint32_t family_count{};
+  f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_count,
+                                              nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_count,
+                                              families.data());
+  bool found{false};
+  for (uint32_t i = 0; i < family_count; ++i) {
+    if (!(families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+      continue;
+    }
+    if (!found || (!timestamp_valid_bits_ && families[i].timestampValidBits)) {
+      found = true;
+      queue_family_index_ = i;
+      timestamp_valid_bits_ = families[i].timestampValidBits;
+    }
+  }
+  if (!found) {
+    qCritical(lcBench, "%s has no compute queue", properties_.deviceName);
+    return false;
+  }
+
+  // Half precision arithmetic is optional, enable it where it exists.
+  std::vector<const char*> extensions;
+  VkPhysicalDeviceShaderFloat16Int8Features float16_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES};
+  const bool core_float16 = properties_.apiVersion >= VK_API_VERSION_1_2;
+  auto get_features2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+      instance_->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+  if (instance_->apiVersion() >= QVersionNumber(1, 1) && get_features2 &&
+      (core_float16 ||
+       HasExtension(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME))) {
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &float16_features};
+    get_features2(physical_device_, &features);
+    has_float16_ = float16_features.shaderFloat16;
+    if (has_float16_ && !core_float16) {
+      extensions.push_back(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+    }
+  }
+  float16_features.pNext = nullptr;
+  float16_features.shaderInt8 = VK_FALSE;
+
+  const float priority{1.0f};
+  VkDeviceQueueCreateInfo queue_info{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = queue_family_index_,
+      .queueCount = 1,
+      .pQueuePriorities = &priority};
+  VkDeviceCreateInfo device_info{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = has_float16_ ? &float16_features : nullptr,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+      .enabledExtensionCount = uint32_t(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data()};
+  VkResult err =
+      f->vkCreateDevice(physical_device_, &device_info, nullptr, &device_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create device: %d", err);
+    return false;
+  }
+  functions_ = instance_->deviceFunctions(device_);
+  functions_->vkGetDeviceQueue(device_, queue_family_index_, 0, &queue_);
+
+  VkCommandPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queue_family_index_};
+  err = functions_->vkCreateCommandPool(device_, &pool_info, nullptr,
+                                        &command_pool_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create command pool: %d", err);
+    return false;
+  }
+  VkCommandBufferAllocateInfo cb_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = command_pool_,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+  err = functions_->vkAllocateCommandBuffers(device_, &cb_info,
+                                             &command_buffer_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to allocate command buffer: %d", err);
+    return false;
+  }
+  VkFenceCreateInfo fence_info{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  err = functions_->vkCreateFence(device_, &fence_info, nullptr, &fence_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create fence: %d", err);
+    return false;
+  }
+
+  if (timestamp_valid_bits_) {
+    VkQueryPoolCreateInfo query_info{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2};
+    err = functions_->vkCreateQueryPool(device_, &query_info, nullptr,
+                                        &query_pool_);
+    if (err != VK_SUCCESS) {
+      qWarning(lcBench, "No timestamp queries (%d), timing on the CPU", err);
+      timestamp_valid_bits_ = 0;
+    }
+  }
+  cpu_timer_.start();
+  return true;
+}
+
+VkCommandBuffer BenchDevice::Begin() noexcept {
+  functions_->vkResetCommandBuffer(command_buffer_, 0);
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  functions_->vkBeginCommandBuffer(command_buffer_, &begin_info);
+  if (timestamp_valid_bits_) {
+    functions_->vkCmdResetQueryPool(command_buffer_, query_pool_, 0, 2);
+    functions_->vkCmdWriteTimestamp(command_buffer_,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                    query_pool_, 0);
+  }
+  return command_buffer_;
+}
+
+double BenchDevice::End() noexcept {
+  if (timestamp_valid_bits_) {
+    functions_->vkCmdWriteTimestamp(command_buffer_,
+                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                    query_pool_, 1);
+  }
+  functions_->vkEndCommandBuffer(command_buffer_);
+
+  const qint64 cpu_ns = SubmitAndWait();
+  if (cpu_ns < 0 || !timestamp_valid_bits_) {
+    return double(cpu_ns);
+  }
+
+  quint64 timestamps[2]{};
+  VkResult err = functions_->vkGetQueryPoolResults(
+      device_, query_pool_, 0, 2, sizeof(timestamps), timestamps,
+      sizeof(quint64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+  if (err != VK_SUCCESS) {
+    return double(cpu_ns);
+  }
+  const quint64 mask = timestamp_valid_bits_ >= 64
+                           ? ~0ULL
+                           : (1ULL << timestamp_valid_bits_) - 1;
+  const quint64 ticks = ((timestamps[1] & mask) - (timestamps[0] & mask)) &
+                        mask;
+  return double(ticks) * properties_.limits.timestampPeriod;
+}
+
+double BenchDevice::RoundTrip() noexcept {
+  functions_->vkResetCommandBuffer(command_buffer_, 0);
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  functions_->vkBeginCommandBuffer(command_buffer_, &begin_info);
+  functions_->vkEndCommandBuffer(command_buffer_);
+  return double(SubmitAndWait());
+}
+
+bool BenchDevice::CreateBuffer(VkDeviceSize size,
+                               VkBufferUsageFlags usage,
+                               uint32_t memory_type,
+                               Buffer* buffer) noexcept {
+  VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                 .size = size,
+                                 .usage = usage};
+  if (functions_->vkCreateBuffer(device_, &buffer_info, nullptr,
+                                 &buffer->buffer) != VK_SUCCESS) {
+    return false;
+  }
+  VkMemoryRequirements requirements;
+  functions_->vkGetBufferMemoryRequirements(device_, buffer->buffer,
+                                            &requirements);
+  if (!(requirements.memoryTypeBits & (1U << memory_type))) {
+    DestroyBuffer(buffer);
+    return false;
+  }
+  VkMemoryAllocateInfo alloc_info{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .allocationSize = requirements.size,
+      .memoryTypeIndex = memory_type};
+  if (functions_->vkAllocateMemory(device_, &alloc_info, nullptr,
+                                   &buffer->memory) != VK_SUCCESS ||
+      functions_->vkBindBufferMemory(device_, buffer->buffer, buffer->memory,
+                                     0) != VK_SUCCESS) {
+    DestroyBuffer(buffer);
+    return false;
+  }
+  buffer->size = size;
+  return true;
+}
+
+void BenchDevice::DestroyBuffer(Buffer* buffer) noexcept {
+  if (buffer->buffer) {
+    functions_->vkDestroyBuffer(device_, buffer->buffer, nullptr);
+  }
+  if (buffer->memory) {
+    functions_->vkFreeMemory(device_, buffer->memory, nullptr);
+  }
+  *buffer = {};
+}
+
+bool BenchDevice::HasExtension(const char* name) const {
+  QVulkanFunctions* f = instance_->functions();
+  uint32_t count{};
+  f->vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &count,
+                                          nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  f->vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &count,
+                                          extensions.data());
+  for (const VkExtensionProperties& extension : extensions) {
+    if (0 == std::strcmp(extension.extensionName, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+qint64 BenchDevice::SubmitAndWait() {
+  VkSubmitInfo submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                           .commandBufferCount = 1,
+                           .pCommandBuffers = &command_buffer_};
+  const qint64 submit_ns = cpu_timer_.nsecsElapsed();
+  VkResult err = functions_->vkQueueSubmit(queue_, 1, &submit_info, fence_);
+  if (err != VK_SUCCESS) {
+    qWarning(lcBench, "Failed to submit: %d", err);
+    return -1;
+  }
+  functions_->vkWaitForFences(device_, 1, &fence_, VK_TRUE, UINT64_MAX);
+  const qint64 cpu_ns = cpu_timer_.nsecsElapsed() - submit_ns;
+  functions_->vkResetFences(device_, 1, &fence_);
+  return cpu_ns;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+
+// A logical device with a single compute-capable queue and one reusable
+// command buffer, plus what the benchmarks need to time work on it.
+class BenchDevice {
+ public:
+  struct Buffer {
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{};
+  };
+
+  BenchDevice(QVulkanInstance* instance,
+              VkPhysicalDevice physical_device) noexcept;
+  ~BenchDevice();
+
+  // Returns false if the device has no compute queue or cannot be created.
+  bool Create() noexcept;
+
+  VkPhysicalDevice physical_device() const noexcept {
+    return physical_device_;
+  }
+  VkDevice device() const noexcept { return device_; }
+  QVulkanDeviceFunctions* functions() const noexcept { return functions_; }
+  const VkPhysicalDeviceProperties& properties() const noexcept {
+    return properties_;
+  }
+  const VkPhysicalDeviceMemoryProperties& memory_properties() const noexcept {
+    return memory_properties_;
+  }
+  // Without timestamps End() falls back to CPU time from submit to fence.
+  bool has_timestamps() const noexcept { return timestamp_valid_bits_ != 0; }
+  // shaderFloat16 is enabled, needs a Vulkan 1.1 instance to be detected.
+  bool has_float16() const noexcept { return has_float16_; }
+
+  // Starts recording the shared command buffer and writes the first
+  // timestamp.
+  VkCommandBuffer Begin() noexcept;
+  // Writes the second timestamp, submits, waits and returns the nanoseconds
+  // in between, or a negative value if the submission failed.
+  double End() noexcept;
+  // Submits an empty command buffer and returns the CPU nanoseconds until
+  // its fence signaled.
+  double RoundTrip() noexcept;
+
+  // Creates a buffer bound to its own allocation of `memory_type`. Fails
+  // quietly when the type cannot back the buffer or the heap is exhausted.
+  bool CreateBuffer(VkDeviceSize size,
+                    VkBufferUsageFlags usage,
+                    uint32_t memory_type,
+                    Buffer* buffer) noexcept;
+  void DestroyBuffer(Buffer* buffer) noexcept;
+
+ private:
+  bool HasExtension(const char* name) const;
+  // Returns CPU nanoseconds from submit to signal, or -1.
+  qint64 SubmitAndWait();
+
+  QVulkanInstance* instance_;
+  VkPhysicalDevice physical_device_;
+  VkPhysicalDeviceProperties properties_{};
+  VkPhysicalDeviceMemoryProperties memory_properties_{};
+  uint32_t queue_family_index_{};
+  uint32_t timestamp_valid_bits_{};
+  bool has_float16_{false};
+
+  VkDevice device_{VK_NULL_HANDLE};
+  QVulkanDeviceFunctions* functions_{};
+  VkQueue queue_{VK_NULL_HANDLE};
+  VkCommandPool command_pool_{VK_NULL_HANDLE};
+  VkCommandBuffer command_buffer_{VK_NULL_HANDLE};
+  VkFence fence_{VK_NULL_HANDLE};
+  VkQueryPool query_pool_{VK_NULL_HANDLE};
+  QElapsedTimer cpu_timer_;
+};
@@ -0,0 +1,335 @@
+#include "compute_benchmark.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QtCore/QFile>
+#include <QtCore/QLoggingCategory>
+
+#include "tracing.h"
+
+static Q_LOGGING_CATEGORY(lcBench, "VkInfo.bench")
+
+namespace {
+constexpr uint32_t kLocalSize{256};  // local_size_x of every kernel
+constexpr uint32_t kMaxGroups{1024};
+constexpr uint32_t kMaxIterations{1 << 16};
+// Dispatches grow until one takes at least this long.
+constexpr double kMinTimeNs{20e6};
+constexpr int kEmptyDispatches{1000};
+constexpr int kRoundTrips{100};
+
+// Per invocation and loop iteration, see the kernels.
+constexpr double kFlopsPerIteration{8 * 4 * 2};  // 8 vec4 FMAs
+constexpr double kSharedBytesPerIteration{4 * 16};  // 4 vec4 loads
+
+struct PushConstants {
+  uint32_t iterations;
+  uint32_t mask;
+};
+}  // namespace
+
+ComputeBenchmark::ComputeBenchmark(BenchDevice* device) noexcept
+    : device_(device) {}
+
+ComputeBenchmark::~ComputeBenchmark() {
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+  df->vkDeviceWaitIdle(device);
+  for (VkPipeline pipeline :
+       {empty_, fma_fp32_, fma_fp16_, shared_memory_, atomics_}) {
+    if (pipeline) {
+      df->vkDestroyPipeline(device, pipeline, nullptr);
+    }
+  }
+  if (pipeline_layout_) {
+    df->vkDestroyPipelineLayout(device, pipeline_layout_, nullptr);
+  }
+  if (descriptor_pool_) {
+    df->vkDestroyDescriptorPool(device, descriptor_pool_, nullptr);
+  }
+  if (set_layout_) {
+    df->vkDestroyDescriptorSetLayout(device, set_layout_, nullptr);
+  }
+  device_->DestroyBuffer(&buffer_);
+}
+
+QJsonObject ComputeBenchmark::Run() noexcept {
+  TRACE_SCOPE("bench", "ComputeBenchmark");
+  QJsonObject json{{"fma_fp32_gflops", -1},
+                   {"fma_fp16_gflops", -1},
+                   {"shared_memory_gbps", -1},
+                   {"atomics_contended_gops", -1},
+                   {"atomics_spread_gops", -1},
+                   {"empty_dispatch_us", -1},
+                   {"empty_dispatch_barrier_us", -1},
+                   {"submit_fence_us", -1}};
+  qInfo(lcBench, "Compute benchmark on %s, %s",
+        device_->properties().deviceName,
+        device_->has_timestamps() ? "GPU timestamps" : "CPU timing");
+  if (!Init()) {
+    return json;
+  }
+
+  const auto report = [&json](const char* key, const char* label,
+                              double value, const char* unit) {
+    json[key] = value;
+    if (value < 0) {
+      qInfo(lcBench, "  %-24s n/a", label);
+    } else {
+      qInfo(lcBench, "  %-24s %10.2f %s", label, value, unit);
+    }
+  };
+  report("fma_fp32_gflops", "fma fp32",
+         Throughput(fma_fp32_, kFlopsPerIteration), "GFLOPs");
+  if (device_->has_float16()) {
+    report("fma_fp16_gflops", "fma fp16",
+           Throughput(fma_fp16_, kFlopsPerIteration), "GFLOPs");
+  } else {
+    qInfo(lcBench, "  %-24s n/a (no shaderFloat16)", "fma fp16");
+  }
+  report("shared_memory_gbps", "shared memory",
+         Throughput(shared_memory_, kSharedBytesPerIteration), "GB/s");
+  report("atomics_contended_gops", "atomics, one address",
+         Throughput(atomics_, 1), "Gop/s");
+  report("atomics_spread_gops", "atomics, own address",
+         Throughput(atomics_, 1, true), "Gop/s");
+  report("empty_dispatch_us", "empty dispatch", EmptyDispatch(false), "us");
+  report("empty_dispatch_barrier_us", "empty dispatch + barrier",
+         EmptyDispatch(true), "us");
+  report("submit_fence_us", "submit + fence", SubmitRoundTrip(), "us");
+  return json;
+}
+
+bool ComputeBenchmark::Init() {
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+
+  // Results and counters, one 32-bit value per invocation of the largest
+  // dispatch. Device local where possible.
+  const VkDeviceSize size = VkDeviceSize(kMaxGroups) * kLocalSize * 4;
+  const VkPhysicalDeviceMemoryProperties& memory =
+      device_->memory_properties();
+  for (bool device_local : {true, false}) {
+    for (uint32_t i = 0; i < memory.memoryTypeCount && !buffer_.buffer; ++i) {
+      const bool is_device_local = memory.memoryTypes[i].propertyFlags &
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      if (is_device_local == device_local) {
+        device_->CreateBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, i,
+                              &buffer_);
+      }
+    }
+  }
+  if (!buffer_.buffer) {
+    qCritical(lcBench, "Failed to create the storage buffer");
+    return false;
+  }
+
+  VkDescriptorSetLayoutBinding binding{
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT};
+  VkDescriptorSetLayoutCreateInfo set_layout_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 1,
+      .pBindings = &binding};
+  VkResult err = df->vkCreateDescriptorSetLayout(device, &set_layout_info,
+                                                 nullptr, &set_layout_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create descriptor set layout: %d", err);
+    return false;
+  }
+
+  VkDescriptorPoolSize pool_size{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .descriptorCount = 1};
+  VkDescriptorPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = 1,
+      .poolSizeCount = 1,
+      .pPoolSizes = &pool_size};
+  err = df->vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                   &descriptor_pool_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create descriptor pool: %d", err);
+    return false;
+  }
+  VkDescriptorSetAllocateInfo set_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptor_pool_,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &set_layout_};
+  err = df->vkAllocateDescriptorSets(device, &set_info, &descriptor_set_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to allocate descriptor set: %d", err);
+    return false;
+  }
+  VkDescriptorBufferInfo buffer_info{.buffer = buffer_.buffer,
+                                     .range = VK_WHOLE_SIZE};
+  VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = descriptor_set_,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pBufferInfo = &buffer_info};
+  df->vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+  VkPushConstantRange push_range{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                                 .size = sizeof(PushConstants)};
+  VkPipelineLayoutCreateInfo layout_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &set_layout_,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_range};
+  err = df->vkCreatePipelineLayout(device, &layout_info, nullptr,
+                                   &pipeline_layout_);
+  if (err != VK_SUCCESS) {
+    qCritical(lcBench, "Failed to create pipeline layout: %d", err);
+    return false;
+  }
+
+  empty_ = CreatePipeline(":/empty_comp.spv");
+  fma_fp32_ = CreatePipeline(":/fma_fp32_comp.spv");
+  if (device_->has_float16()) {
+    fma_fp16_ = CreatePipeline(":/fma_fp16_comp.spv");
+  }
+  shared_memory_ = CreatePipeline(":/shared_memory_comp.spv");
+  atomics_ = CreatePipeline(":/atomics_comp.spv");
+  return true;
+}
+
+VkPipeline ComputeBenchmark::CreatePipeline(const QString& shader) {
+  QFile file(shader);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning(lcBench, "Failed to read shader %s", qPrintable(shader));
+    return VK_NULL_HANDLE;
+  }
+  const QByteArray blob = file.readAll();
+
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+  VkShaderModuleCreateInfo shader_info{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = static_cast<size_t>(blob.size()),
+      .pCode = reinterpret_cast<const uint32_t*>(blob.constData())};
+  VkShaderModule shader_module;
+  VkResult err =
+      df->vkCreateShaderModule(device, &shader_info, nullptr, &shader_module);
+  if (err != VK_SUCCESS) {
+    qWarning(lcBench, "Failed to create shader module: %d", err);
+    return VK_NULL_HANDLE;
+  }
+
+  VkComputePipelineCreateInfo pipeline_info{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main"},
+      .layout = pipeline_layout_};
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  err = df->vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
+                                     &pipeline_info, nullptr, &pipeline);
+  df->vkDestroyShaderModule(device, shader_module, nullptr);
+  if (err != VK_SUCCESS) {
+    qWarning(lcBench, "Failed to create compute pipeline %s: %d",
+             qPrintable(shader), err);
+    return VK_NULL_HANDLE;
+  }
+  return pipeline;
+}
+
+double ComputeBenchmark::Dispatch(VkPipeline pipeline,
+                                  uint32_t groups,
+                                  uint32_t iterations,
+                                  uint32_t mask) {
+  TRACE_SCOPE("bench", "Dispatch");
+  QVulkanDeviceFunctions* df = device_->functions();
+  const PushConstants push{.iterations = iterations, .mask = mask};
+  VkCommandBuffer cb = device_->Begin();
+  df->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  df->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              pipeline_layout_, 0, 1, &descriptor_set_, 0,
+                              nullptr);
+  df->vkCmdPushConstants(cb, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(push), &push);
+  df->vkCmdDispatch(cb, groups, 1, 1);
+  return device_->End();
+}
+
+double ComputeBenchmark::Throughput(VkPipeline pipeline,
+                                    double units,
+                                    bool spread) {
+  if (!pipeline) {
+    return -1;
+  }
+  // Start small so slow (software) devices finish quickly, fill the device
+  // with workgroups first, then make each invocation do more.
+  uint32_t groups = 16;
+  uint32_t iterations = 16;
+  double ns = 0;
+  for (;;) {
+    const uint32_t mask = spread ? groups * kLocalSize - 1 : 0;
+    ns = Dispatch(pipeline, groups, iterations, mask);
+    if (ns < 0) {
+      return -1;
+    }
+    if (ns >= kMinTimeNs ||
+        (groups >= kMaxGroups && iterations >= kMaxIterations)) {
+      break;
+    }
+    if (groups < kMaxGroups) {
+      groups *= 2;
+    } else {
+      iterations *= 2;
+    }
+  }
+  return double(groups) * kLocalSize * iterations * units / ns;
+}
+
+double ComputeBenchmark::EmptyDispatch(bool barrier) {
+  if (!empty_) {
+    return -1;
+  }
+  QVulkanDeviceFunctions* df = device_->functions();
+  const VkMemoryBarrier memory_barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+  double best_ns = -1;
+  // The first run warms up the pipeline, keep the faster of two.
+  for (int run = 0; run < 2; ++run) {
+    VkCommandBuffer cb = device_->Begin();
+    df->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, empty_);
+    for (int i = 0; i < kEmptyDispatches; ++i) {
+      if (barrier && i) {
+        df->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &memory_barrier, 0, nullptr, 0, nullptr);
+      }
+      df->vkCmdDispatch(cb, 1, 1, 1);
+    }
+    const double ns = device_->End();
+    if (ns > 0 && (best_ns < 0 || ns < best_ns)) {
+      best_ns = ns;
+    }
+  }
+  return best_ns > 0 ? best_ns / 1e3 / kEmptyDispatches : -1;
+}
+
+double ComputeBenchmark::SubmitRoundTrip() {
+  std::vector<double> samples;
+  samples.reserve(kRoundTrips);
+  device_->RoundTrip();
+  for (int i = 0; i < kRoundTrips; ++i) {
+    const double ns = device_->RoundTrip();
+    if (ns < 0) {
+      return -1;
+    }
+    samples.push_back(ns);
+  }
+  std::nth_element(samples.begin(), samples.begin() + kRoundTrips / 2,
+                   samples.end());
+  return samples[kRoundTrips / 2] / 1e3;
+}
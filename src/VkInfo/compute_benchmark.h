@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+#include "bench_device.h"
+
+// Compute micro-benchmarks from the kernels in res/: FMA throughput in fp32
+// and fp16, shared memory bandwidth, atomics with and without contention,
+// plus the cost of an empty dispatch and of a submit/fence round trip.
+// Kernels are timed with timestamp queries where the queue supports them.
+class ComputeBenchmark {
+ public:
+  explicit ComputeBenchmark(BenchDevice* device) noexcept;
+  ~ComputeBenchmark();
+
+  // Logs one line per measurement and returns them for the JSON file;
+  // values that could not be measured are -1.
+  QJsonObject Run() noexcept;
+
+ private:
+  bool Init();
+  VkPipeline CreatePipeline(const QString& shader);
+
+  // Runs `groups` workgroups of 256 invocations once, returns nanoseconds.
+  double Dispatch(VkPipeline pipeline,
+                  uint32_t groups,
+                  uint32_t iterations,
+                  uint32_t mask);
+  // Grows the dispatch until it runs long enough to time, then returns
+  // `units` (per invocation and iteration) per nanosecond, i.e. G/s.
+  double Throughput(VkPipeline pipeline, double units, bool spread = false);
+  // Microseconds per back-to-back vkCmdDispatch(1, 1, 1).
+  double EmptyDispatch(bool barrier);
+  // Median microseconds from vkQueueSubmit to the fence signaling.
+  double SubmitRoundTrip();
+
+  BenchDevice* device_;
+  BenchDevice::Buffer buffer_;
+  VkDescriptorSetLayout set_layout_{VK_NULL_HANDLE};
+  VkDescriptorPool descriptor_pool_{VK_NULL_HANDLE};
+  VkDescriptorSet descriptor_set_{VK_NULL_HANDLE};
+  VkPipelineLayout pipeline_layout_{VK_NULL_HANDLE};
+  VkPipeline empty_{VK_NULL_HANDLE};
+  VkPipeline fma_fp32_{VK_NULL_HANDLE};
+  VkPipeline fma_fp16_{VK_NULL_HANDLE};
+  VkPipeline shared_memory_{VK_NULL_HANDLE};
+  VkPipeline atomics_{VK_NULL_HANDLE};
+};
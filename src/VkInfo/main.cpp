@@ -2,26 +2,81 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <vector>
 
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QVersionNumber>
 #include <QtGui/QGuiApplication>
 #include <QtGui/QVulkanFunctions>
 #include <QtGui/QVulkanInstance>
 
 #include <vulkan/vulkan_core.h>
 
+#include "bench.h"
+#include "bench_device.h"
+#include "compute_benchmark.h"
+#include "memory_benchmark.h"
+#include "tracing.h"
+#include "tuning_profile.h"
+
 static Q_LOGGING_CATEGORY(lcVp, "VkInfo")
 
 auto main(int argc, char* argv[]) -> int {
+  // Benchmarks have to run in CI without a display.
+  for (int i = 1; i < argc; ++i) {
+    if ((0 == std::strncmp(argv[i], "--bench-", 8) ||
+         0 == std::strcmp(argv[i], "--tuning-profile")) &&
+        qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+  }
+
   // Should be QGuiApplication for Vulkan support
   // QCoreApplication a(argc, argv);
   const QGuiApplication app(argc, argv);
+  tracing::StartFromEnvironment();
   qDebug(lcVp) << "Current Platform:" << QGuiApplication::platformName();
 
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  const QCommandLineOption bench_memory_option(
+      "bench-memory",
+      "Measure host and transfer bandwidth plus map/flush latency of every "
+      "memory type.");
+  const QCommandLineOption bench_compute_option(
+      "bench-compute",
+      "Measure FMA, shared memory and atomics throughput plus dispatch and "
+      "submit overhead.");
+  const QCommandLineOption tuning_profile_option(
+      "tuning-profile",
+      "Probe and measure each device, then write its tuning profile to the "
+      "cache the renderers load it from.");
+  const QCommandLineOption device_option(
+      "device", "Only benchmark this physical device (default: all).",
+      "index");
+  const QCommandLineOption json_option(
+      "json", "Write benchmark results as JSON to <file>.", "file");
+  parser.addOptions({bench_memory_option, bench_compute_option,
+                     tuning_profile_option, device_option, json_option});
+  bench::AddOptions(&parser);
+  parser.process(app);
+  const bool bench = parser.isSet(bench_memory_option) ||
+                     parser.isSet(bench_compute_option) ||
+                     parser.isSet(tuning_profile_option);
+
   QLoggingCategory::setFilterRules(QStringLiteral("qt.vulkan=true"));
 
   QVulkanInstance vulkan_instance;
+  if (bench) {
+    // Needed to query optional features such as shaderFloat16.
+    vulkan_instance.setApiVersion(QVersionNumber(1, 1));
+  }
 #ifndef Q_OS_ANDROID
   vulkan_instance.setLayers(QByteArrayList()
                             << "VK_LAYER_LUNARG_standard_validation");
@@ -135,5 +190,80 @@ auto main(int argc, char* argv[]) -> int {
     }
   }
 
+  if (!bench) {
+    return EXIT_SUCCESS;
+  }
+
+  const bench::Options bench_options = bench::ParseOptions(parser);
+  bench::Suite suite("VkInfo");
+  QJsonArray devices;
+  for (uint32_t i = 0; i < physical_device_count; ++i) {
+    if (parser.isSet(device_option) &&
+        parser.value(device_option).toUInt() != i) {
+      continue;
+    }
+    BenchDevice bench_device(&vulkan_instance, physical_devices.at(i));
+    if (!bench_device.Create()) {
+      continue;
+    }
+
+    const VkPhysicalDeviceProperties& properties = bench_device.properties();
+    QJsonObject json{{"index", int(i)},
+                     {"device", properties.deviceName},
+                     {"vendor_id", int(properties.vendorID)},
+                     {"device_id", int(properties.deviceID)},
+                     {"driver_version", double(properties.driverVersion)}};
+    // Metrics are keyed by device index, names carry driver versions.
+    const QString prefix = QString::number(i);
+    if (parser.isSet(bench_memory_option)) {
+      suite.Run(bench_options, [&] {
+        const QJsonArray types = MemoryBenchmark(&bench_device).Run();
+        suite.AddJson(prefix, QJsonObject{{"memory_types", types}});
+        json["memory_types"] = types;
+        return true;
+      });
+    }
+    if (parser.isSet(bench_compute_option)) {
+      suite.Run(bench_options, [&] {
+        const QJsonObject compute = ComputeBenchmark(&bench_device).Run();
+        suite.AddJson(prefix, QJsonObject{{"compute", compute}});
+        json["compute"] = compute;
+        return true;
+      });
+    }
+    if (parser.isSet(tuning_profile_option)) {
+      TuningProfile profile =
+          TuningProfile::Probe(&vulkan_instance, physical_devices.at(i));
+      if (profile.upload_type >= 0 && profile.device_local_type >= 0) {
+        MemoryBenchmark memory_benchmark(&bench_device);
+        profile.upload_chunk_size = memory_benchmark.UploadChunkSize(
+            uint32_t(profile.upload_type), uint32_t(profile.device_local_type));
+      }
+      const QString path = TuningProfile::PathFor(properties);
+      if (profile.Save(path)) {
+        qInfo(lcVp, "Tuning profile written to %s", qPrintable(path));
+      }
+      json["tuning_profile"] = profile.ToJson();
+    }
+    devices.append(json);
+  }
+  if (devices.isEmpty()) {
+    qCritical(lcVp, "No device could be benchmarked");
+    return EXIT_FAILURE;
+  }
+  suite.Log();
+
+  const QString json_path = parser.value(json_option);
+  if (!json_path.isEmpty()) {
+    QFile file(json_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      qCritical(lcVp, "Failed to write %s", qPrintable(json_path));
+      return EXIT_FAILURE;
+    }
+    file.write(QJsonDocument(QJsonObject{{"benchmark", "VkInfo"},
+                                         {"devices", devices},
+                                         {"bench", suite.ToJson()}})
+                   .toJson());
+  }
   return EXIT_SUCCESS;
 }
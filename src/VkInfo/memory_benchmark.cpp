@@ -0,0 +1,381 @@
+#include "memory_benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QLoggingCategory>
+
+#include "tracing.h"
+
+static Q_LOGGING_CATEGORY(lcBench, "VkInfo.bench")
+
+namespace {
+constexpr VkDeviceSize kSizes[] = {64 << 10, 1 << 20, 16 << 20};
+// Each measurement repeats until it took at least this long.
+constexpr qint64 kMinTimeNs{20'000'000};
+constexpr int kMinIterations{3};
+// Copies per command buffer, so that small sizes are not all overhead.
+constexpr VkDeviceSize kCopyBytesPerSubmit{64 << 20};
+constexpr int kMaxCopiesPerSubmit{64};
+constexpr int kLatencyIterations{100};
+constexpr VkDeviceSize kUploadChunkSizes[] = {64 << 10, 256 << 10, 1 << 20,
+                                              4 << 20, 16 << 20};
+constexpr VkDeviceSize kUploadBytes{32 << 20};
+
+// Average nanoseconds per call of `f`, after one untimed warmup call.
+template <typename F>
+double TimePerCall(F&& f) {
+  f();
+  QElapsedTimer timer;
+  timer.start();
+  int iterations = 0;
+  do {
+    f();
+    ++iterations;
+  } while (iterations < kMinIterations || timer.nsecsElapsed() < kMinTimeNs);
+  return double(timer.nsecsElapsed()) / iterations;
+}
+
+QByteArray FlagsString(VkMemoryPropertyFlags flags) {
+  QByteArrayList names;
+  if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    names << "DL";
+  if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    names << "HV";
+  if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    names << "HC";
+  if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+    names << "HCa";
+  if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+    names << "LA";
+  if (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT)
+    names << "P";
+  return names.isEmpty() ? QByteArray("-") : names.join('|');
+}
+
+QByteArray Cell(double value) {
+  return value < 0 ? QByteArray("-") : QByteArray::number(value, 'f', 2);
+}
+
+QByteArray SizeString(VkDeviceSize size) {
+  return size >= (1 << 20) ? QByteArray::number(size >> 20) + " MiB"
+                           : QByteArray::number(size >> 10) + " KiB";
+}
+}  // namespace
+
+MemoryBenchmark::MemoryBenchmark(BenchDevice* device) noexcept
+    : device_(device) {
+  const VkPhysicalDeviceMemoryProperties& memory =
+      device_->memory_properties();
+  // On a discrete GPU that is VRAM proper, not the host visible window.
+  bool found{false};
+  bool found_host_visible{false};
+  for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+    const VkMemoryPropertyFlags flags = memory.memoryTypes[i].propertyFlags;
+    if (!(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ||
+        (flags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT |
+                  VK_MEMORY_PROPERTY_PROTECTED_BIT))) {
+      continue;
+    }
+    const bool host_visible = flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    if (!found || (found_host_visible && !host_visible)) {
+      found = true;
+      found_host_visible = host_visible;
+      reference_type_ = i;
+    }
+  }
+}
+
+QJsonArray MemoryBenchmark::Run() noexcept {
+  TRACE_SCOPE("bench", "MemoryBenchmark");
+  const VkPhysicalDeviceMemoryProperties& memory =
+      device_->memory_properties();
+  qInfo(lcBench, "Memory benchmark on %s, copies against type %u, %s",
+        device_->properties().deviceName, reference_type_,
+        device_->has_timestamps() ? "GPU timestamps" : "CPU timing");
+  qInfo(lcBench, "  %-4s %-4s %-13s %-7s %9s %9s %9s %9s %9s", "type", "heap",
+        "flags", "size", "write", "read", "copy in", "copy out", "copy self");
+  qInfo(lcBench, "  %-31s %9s %9s %9s %9s %9s", "", "GB/s", "GB/s", "GB/s",
+        "GB/s", "GB/s");
+
+  QJsonArray types;
+  for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+    const VkMemoryType& type = memory.memoryTypes[i];
+    const VkDeviceSize heap_size = memory.memoryHeaps[type.heapIndex].size;
+    const QByteArray flags = FlagsString(type.propertyFlags);
+    QJsonObject json{{"index", int(i)},
+                     {"heap_index", int(type.heapIndex)},
+                     {"heap_size", double(heap_size)},
+                     {"property_flags", int(type.propertyFlags)},
+                     {"flags", QString::fromLatin1(flags)}};
+
+    // Lazily allocated memory only backs transient attachments and protected
+    // memory cannot be read back, neither can hold a plain buffer.
+    if (type.propertyFlags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT |
+                              VK_MEMORY_PROPERTY_PROTECTED_BIT)) {
+      qInfo(lcBench, "  %-4u %-4u %-13s skipped", i, type.heapIndex,
+            flags.constData());
+      types.append(json);
+      continue;
+    }
+
+    QJsonArray sizes;
+    for (VkDeviceSize size : kSizes) {
+      // Leave most of the heap to the reference buffer and everyone else.
+      if (size > heap_size / 8) {
+        continue;
+      }
+      const QJsonObject result = MeasureSize(i, size);
+      qInfo(lcBench, "  %-4u %-4u %-13s %-7s %9s %9s %9s %9s %9s", i,
+            type.heapIndex, flags.constData(), SizeString(size).constData(),
+            Cell(result["host_write_gbps"].toDouble()).constData(),
+            Cell(result["host_read_gbps"].toDouble()).constData(),
+            Cell(result["copy_in_gbps"].toDouble()).constData(),
+            Cell(result["copy_out_gbps"].toDouble()).constData(),
+            Cell(result["copy_self_gbps"].toDouble()).constData());
+      sizes.append(result);
+    }
+    json["sizes"] = sizes;
+
+    const QJsonObject latency = MeasureLatency(i);
+    if (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+      qInfo(lcBench, "  %-4u map+unmap %s us, flush %s us, invalidate %s us",
+            i, Cell(latency["map_us"].toDouble()).constData(),
+            Cell(latency["flush_us"].toDouble()).constData(),
+            Cell(latency["invalidate_us"].toDouble()).constData());
+    }
+    for (auto it = latency.begin(); it != latency.end(); ++it) {
+      json[it.key()] = it.value();
+    }
+    types.append(json);
+  }
+  return types;
+}
+
+QJsonObject MemoryBenchmark::MeasureLatency(uint32_t memory_type) {
+  QJsonObject json{{"map_us", -1}, {"flush_us", -1}, {"invalidate_us", -1}};
+  const VkMemoryPropertyFlags flags =
+      device_->memory_properties().memoryTypes[memory_type].propertyFlags;
+  if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+    return json;
+  }
+
+  BenchDevice::Buffer buffer;
+  if (!device_->CreateBuffer(kSizes[0], VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             memory_type, &buffer)) {
+    return json;
+  }
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+
+  QElapsedTimer timer;
+  timer.start();
+  void* mapped{};
+  for (int i = 0; i < kLatencyIterations; ++i) {
+    df->vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    df->vkUnmapMemory(device, buffer.memory);
+  }
+  json["map_us"] = timer.nsecsElapsed() / 1e3 / kLatencyIterations;
+
+  // Flushing coherent memory is allowed and tells what the call itself costs.
+  if (df->vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) ==
+      VK_SUCCESS) {
+    const VkMappedMemoryRange range{
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = buffer.memory,
+        .size = VK_WHOLE_SIZE};
+    timer.restart();
+    for (int i = 0; i < kLatencyIterations; ++i) {
+      static_cast<quint8*>(mapped)[0] = quint8(i);
+      df->vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+    json["flush_us"] = timer.nsecsElapsed() / 1e3 / kLatencyIterations;
+    timer.restart();
+    for (int i = 0; i < kLatencyIterations; ++i) {
+      df->vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+    json["invalidate_us"] = timer.nsecsElapsed() / 1e3 / kLatencyIterations;
+    df->vkUnmapMemory(device, buffer.memory);
+  }
+
+  device_->DestroyBuffer(&buffer);
+  return json;
+}
+
+QJsonObject MemoryBenchmark::MeasureSize(uint32_t memory_type,
+                                         VkDeviceSize size) {
+  TRACE_SCOPE("bench", "MeasureSize");
+  QJsonObject json{{"bytes", double(size)},  {"host_write_gbps", -1},
+                   {"host_read_gbps", -1},   {"copy_in_gbps", -1},
+                   {"copy_out_gbps", -1},    {"copy_self_gbps", -1}};
+  const VkMemoryPropertyFlags flags =
+      device_->memory_properties().memoryTypes[memory_type].propertyFlags;
+  constexpr VkBufferUsageFlags kUsage =
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+  BenchDevice::Buffer buffer;
+  if (!device_->CreateBuffer(size, kUsage, memory_type, &buffer)) {
+    qWarning(lcBench, "Cannot allocate %llu bytes of memory type %u",
+             qulonglong(size), memory_type);
+    return json;
+  }
+
+  if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    const bool coherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    json["host_write_gbps"] = HostWrite(buffer, coherent);
+    json["host_read_gbps"] = HostRead(buffer, coherent);
+  }
+
+  BenchDevice::Buffer reference;
+  if (device_->CreateBuffer(size, kUsage, reference_type_, &reference)) {
+    json["copy_in_gbps"] = Copy(reference, buffer);
+    json["copy_out_gbps"] = Copy(buffer, reference);
+    device_->DestroyBuffer(&reference);
+  }
+  BenchDevice::Buffer other;
+  if (device_->CreateBuffer(size, kUsage, memory_type, &other)) {
+    json["copy_self_gbps"] = Copy(buffer, other);
+    device_->DestroyBuffer(&other);
+  }
+
+  device_->DestroyBuffer(&buffer);
+  return json;
+}
+
+double MemoryBenchmark::HostWrite(const BenchDevice::Buffer& buffer,
+                                  bool coherent) {
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+  void* mapped{};
+  if (df->vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) !=
+      VK_SUCCESS) {
+    return -1;
+  }
+  const std::vector<quint8> source(buffer.size, 0x5a);
+  const VkMappedMemoryRange range{
+      .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+      .memory = buffer.memory,
+      .size = VK_WHOLE_SIZE};
+  // Non-coherent writes only count once they are flushed.
+  const double ns = TimePerCall([&] {
+    std::memcpy(mapped, source.data(), buffer.size);
+    if (!coherent) {
+      df->vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+  });
+  df->vkUnmapMemory(device, buffer.memory);
+  return buffer.size / ns;
+}
+
+double MemoryBenchmark::HostRead(const BenchDevice::Buffer& buffer,
+                                 bool coherent) {
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+  void* mapped{};
+  if (df->vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) !=
+      VK_SUCCESS) {
+    return -1;
+  }
+  std::vector<quint8> destination(buffer.size);
+  const VkMappedMemoryRange range{
+      .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+      .memory = buffer.memory,
+      .size = VK_WHOLE_SIZE};
+  // Uncached memory is where this hurts: every read goes over the bus.
+  volatile quint8 sink{};
+  const double ns = TimePerCall([&] {
+    if (!coherent) {
+      df->vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+    std::memcpy(destination.data(), mapped, buffer.size);
+    sink = destination[buffer.size / 2];
+  });
+  df->vkUnmapMemory(device, buffer.memory);
+  return buffer.size / ns;
+}
+
+double MemoryBenchmark::Copy(const BenchDevice::Buffer& src,
+                             const BenchDevice::Buffer& dst) {
+  const int copies = int(std::clamp<VkDeviceSize>(
+      kCopyBytesPerSubmit / src.size, 1, kMaxCopiesPerSubmit));
+  const VkBufferCopy region{.size = std::min(src.size, dst.size)};
+  const VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT};
+  QVulkanDeviceFunctions* df = device_->functions();
+
+  double best_ns = -1;
+  // The first submission pages everything in; keep the faster of two.
+  for (int run = 0; run < 2; ++run) {
+    VkCommandBuffer cb = device_->Begin();
+    for (int i = 0; i < copies; ++i) {
+      if (i) {
+        df->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                                 &barrier, 0, nullptr, 0, nullptr);
+      }
+      df->vkCmdCopyBuffer(cb, src.buffer, dst.buffer, 1, &region);
+    }
+    const double ns = device_->End();
+    if (ns > 0 && (best_ns < 0 || ns < best_ns)) {
+      best_ns = ns;
+    }
+  }
+  return best_ns > 0 ? double(region.size) * copies / best_ns : -1;
+}
+
+VkDeviceSize MemoryBenchmark::UploadChunkSize(uint32_t upload_type,
+                                              uint32_t device_type) noexcept {
+  constexpr VkDeviceSize kMaxChunk = std::end(kUploadChunkSizes)[-1];
+  BenchDevice::Buffer staging;
+  BenchDevice::Buffer target;
+  void* mapped{};
+  VkDevice device = device_->device();
+  QVulkanDeviceFunctions* df = device_->functions();
+  if (!device_->CreateBuffer(kMaxChunk, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             upload_type, &staging) ||
+      !device_->CreateBuffer(kUploadBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             device_type, &target) ||
+      df->vkMapMemory(device, staging.memory, 0, VK_WHOLE_SIZE, 0, &mapped) !=
+          VK_SUCCESS) {
+    device_->DestroyBuffer(&staging);
+    device_->DestroyBuffer(&target);
+    return 0;
+  }
+
+  const std::vector<quint8> source(kMaxChunk, 0x5a);
+  double gbps[std::size(kUploadChunkSizes)]{};
+  double best_gbps = 0;
+  for (size_t i = 0; i < std::size(kUploadChunkSizes); ++i) {
+    const VkDeviceSize chunk = kUploadChunkSizes[i];
+    QElapsedTimer timer;
+    timer.start();
+    for (VkDeviceSize offset = 0; offset < kUploadBytes; offset += chunk) {
+      std::memcpy(mapped, source.data(), chunk);
+      const VkBufferCopy region{.dstOffset = offset, .size = chunk};
+      VkCommandBuffer cb = device_->Begin();
+      df->vkCmdCopyBuffer(cb, staging.buffer, target.buffer, 1, &region);
+      if (device_->End() < 0) {
+        break;
+      }
+    }
+    gbps[i] = double(kUploadBytes) / timer.nsecsElapsed();
+    best_gbps = std::max(best_gbps, gbps[i]);
+    qInfo(lcBench, "  upload in %-7s chunks %9.2f GB/s",
+          SizeString(chunk).constData(), gbps[i]);
+  }
+  df->vkUnmapMemory(device, staging.memory);
+  device_->DestroyBuffer(&staging);
+  device_->DestroyBuffer(&target);
+
+  for (size_t i = 0; i < std::size(kUploadChunkSizes); ++i) {
+    if (gbps[i] >= 0.95 * best_gbps) {
+      return kUploadChunkSizes[i];
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+
+#include "bench_device.h"
+
+// How each memory type of a device performs: host write/read bandwidth
+// through a mapping, map/flush/invalidate latency, and vkCmdCopyBuffer
+// bandwidth into, out of and within the type, at several transfer sizes.
+// Copies are timed with timestamp queries where the queue supports them.
+class MemoryBenchmark {
+ public:
+  explicit MemoryBenchmark(BenchDevice* device) noexcept;
+
+  // Logs one table row per memory type and size. Returns one JSON object per
+  // memory type; values that could not be measured are -1.
+  QJsonArray Run() noexcept;
+
+  // Streams data from `upload_type` into `device_type` in chunks of several
+  // sizes: write a chunk through the mapping, copy it, wait. Returns the
+  // smallest chunk size within 5% of the best throughput, 0 if it could not
+  // be measured.
+  VkDeviceSize UploadChunkSize(uint32_t upload_type,
+                               uint32_t device_type) noexcept;
+
+ private:
+  QJsonObject MeasureLatency(uint32_t memory_type);
+  QJsonObject MeasureSize(uint32_t memory_type, VkDeviceSize size);
+  // Bytes per nanosecond, i.e. GB/s.
+  double HostWrite(const BenchDevice::Buffer& buffer, bool coherent);
+  double HostRead(const BenchDevice::Buffer& buffer, bool coherent);
+  double Copy(const BenchDevice::Buffer& src, const BenchDevice::Buffer& dst);
+
+  BenchDevice* device_;
+  // Device local, preferably not host visible: the other end of the copies.
+  uint32_t reference_type_{};
+};
@@ -0,0 +1,16 @@
+set GLSLC_BIN="%VCPKG_ROOT%\packages\shaderc_x64-windows\tools\shaderc\glslc.exe"
+if not exist %GLSLC_BIN% (
+    set GLSLC_BIN="%VCPKG_ROOT%\installed\x64-windows\tools\shaderc\glslc.exe"
+)
+if not exist %GLSLC_BIN% (
+    echo GLSL compiler not found. Please ensure shaderc is installed via `vcpkg install shaderc`.
+    pause
+    exit /b 1
+)
+
+%GLSLC_BIN% empty.comp -o empty_comp.spv
+%GLSLC_BIN% fma_fp32.comp -o fma_fp32_comp.spv
+%GLSLC_BIN% fma_fp16.comp -o fma_fp16_comp.spv
+%GLSLC_BIN% shared_memory.comp -o shared_memory_comp.spv
+%GLSLC_BIN% atomics.comp -o atomics_comp.spv
+pause
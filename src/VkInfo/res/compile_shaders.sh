@@ -0,0 +1,6 @@
+# sudo apt install glslc
+glslc empty.comp -o empty_comp.spv
+glslc fma_fp32.comp -o fma_fp32_comp.spv
+glslc fma_fp16.comp -o fma_fp16_comp.spv
+glslc shared_memory.comp -o shared_memory_comp.spv
+glslc atomics.comp -o atomics_comp.spv
@@ -0,0 +1,198 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+
+namespace {
+constexpr qint64 kReportIntervalNs{2'000'000'000};
+}  // namespace
+
+const char* PresentModeName(PresentMode mode) {
+  switch (mode) {
+    case PresentMode::kFifo:
+      return "fifo";
+    case PresentMode::kMailbox:
+      return "mailbox";
+    case PresentMode::kImmediate:
+      return "immediate";
+  }
+  return "?";
+}
+
+VkPresentModeKHR ToVkPresentMode(PresentMode mode) {
+  switch (mode) {
+    case PresentMode::kFifo:
+      return VK_PRESENT_MODE_FIFO_KHR;
+    case PresentMode::kMailbox:
+      return VK_PRESENT_MODE_MAILBOX_KHR;
+    case PresentMode::kImmediate:
+      return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void FramePacer::Init(VkDevice device,
+                      QVulkanDeviceFunctions* device_functions,
+                      VkQueue queue,
+                      int max_frames_in_flight) noexcept {
+  device_ = device;
+  device_functions_ = device_functions;
+  queue_ = queue;
+  slot_count_ = std::clamp(options_.frames_in_flight, 1,
+                           std::min(max_frames_in_flight, kMaxSlots));
+  current_ = 0;
+
+  VkFenceCreateInfo fence_info{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  for (int i = 0; i < slot_count_; ++i) {
+    slots_[i] = {};
+    VkResult err = device_functions_->vkCreateFence(device_, &fence_info,
+                                                    nullptr, &slots_[i].fence);
+    if (err != VK_SUCCESS)
+      qFatal("Failed to create fence: %d", err);
+  }
+
+  clock_.start();
+  pending_input_ns_ = 0;
+  work_ns_ = 0;
+  report_start_ns_ = 0;
+  frames_ = 0;
+  wait_ns_ = 0;
+  latency_samples_ = 0;
+  latency_sum_ns_ = 0;
+  latency_max_ns_ = 0;
+
+  qInfo("Frame pacing: %d of %d frames in flight, %s", slot_count_,
+        max_frames_in_flight,
+        options_.low_latency ? "low latency" : "throughput");
+}
+
+void FramePacer::Release() noexcept {
+  if (!device_) {
+    return;
+  }
+  for (int i = 0; i < slot_count_; ++i) {
+    Retire(&slots_[i], true);
+    device_functions_->vkDestroyFence(device_, slots_[i].fence, nullptr);
+    slots_[i] = {};
+  }
+  slot_count_ = 0;
+  device_ = VK_NULL_HANDLE;
+}
+
+void FramePacer::SetRefreshRate(qreal hz) noexcept {
+  if (hz > 1) {
+    refresh_ns_ = qint64(1e9 / hz);
+  }
+}
+
+void FramePacer::BeginFrame() noexcept {
+  Slot& slot = slots_[current_];
+  const qint64 wait_start = clock_.nsecsElapsed();
+  Retire(&slot, true);
+  wait_ns_ += clock_.nsecsElapsed() - wait_start;
+
+  // Older frames may have finished meanwhile, take their latency samples.
+  for (int i = 0; i < slot_count_; ++i) {
+    Retire(&slots_[i], false);
+  }
+
+  slot.started_ns = clock_.nsecsElapsed();
+  slot.input_ns = pending_input_ns_;
+  pending_input_ns_ = 0;
+}
+
+int FramePacer::EndFrame() noexcept {
+  Slot& slot = slots_[current_];
+  current_ = (current_ + 1) % slot_count_;
+  ++frames_;
+
+  // No batches: the fence signals when all earlier submissions, including
+  // the frame QVulkanWindow just queued, have completed.
+  VkResult err = device_functions_->vkQueueSubmit(queue_, 0, nullptr,
+                                                  slot.fence);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to submit frame fence: %d", err);
+    MaybeReport();
+    return 0;
+  }
+  slot.submitted = true;
+
+  int delay_ms = 0;
+  if (options_.low_latency) {
+    // Let the frame finish first, which also keeps only one in flight, then
+    // start the next one as late as still makes the following refresh.
+    const qint64 wait_start = clock_.nsecsElapsed();
+    Retire(&slot, true);
+    const qint64 now = clock_.nsecsElapsed();
+    wait_ns_ += now - wait_start;
+
+    const qint64 margin_ns = 1'000'000 + work_ns_ / 10;
+    const qint64 next_start_ns =
+        slot.started_ns + refresh_ns_ - work_ns_ - margin_ns;
+    delay_ms = int(std::max<qint64>(next_start_ns - now, 0) / 1'000'000);
+  }
+
+  MaybeReport();
+  return delay_ms;
+}
+
+void FramePacer::OnInput() noexcept {
+  if (!pending_input_ns_ && clock_.isValid()) {
+    pending_input_ns_ = clock_.nsecsElapsed();
+  }
+}
+
+bool FramePacer::Retire(Slot* slot, bool wait) {
+  if (!slot->submitted) {
+    return true;
+  }
+  VkResult result =
+      wait ? device_functions_->vkWaitForFences(device_, 1, &slot->fence,
+                                                VK_TRUE, UINT64_MAX)
+           : device_functions_->vkGetFenceStatus(device_, slot->fence);
+  if (result != VK_SUCCESS) {
+    return false;
+  }
+
+  // Only an upper bound when polled, the fence may have signaled earlier.
+  const qint64 now = clock_.nsecsElapsed();
+  const qint64 work_ns = now - slot->started_ns;
+  work_ns_ = work_ns_ ? (work_ns_ * 7 + work_ns) / 8 : work_ns;
+  if (slot->input_ns) {
+    const qint64 latency_ns = now - slot->input_ns;
+    ++latency_samples_;
+    latency_sum_ns_ += latency_ns;
+    latency_max_ns_ = std::max(latency_max_ns_, latency_ns);
+  }
+
+  device_functions_->vkResetFences(device_, 1, &slot->fence);
+  slot->submitted = false;
+  slot->input_ns = 0;
+  return true;
+}
+
+void FramePacer::MaybeReport() {
+  const qint64 now = clock_.nsecsElapsed();
+  const qint64 elapsed_ns = now - report_start_ns_;
+  if (elapsed_ns < kReportIntervalNs) {
+    return;
+  }
+
+  const int frames = std::max(frames_, 1);
+  if (latency_samples_) {
+    qInfo("%.1f fps, cpu wait %.2f ms/frame, input-to-render-complete "
+          "%.2f ms avg, %.2f ms max (%d inputs)",
+          frames_ * 1e9 / elapsed_ns, wait_ns_ / 1e6 / frames,
+          latency_sum_ns_ / 1e6 / latency_samples_, latency_max_ns_ / 1e6,
+          latency_samples_);
+  } else {
+    qInfo("%.1f fps, cpu wait %.2f ms/frame", frames_ * 1e9 / elapsed_ns,
+          wait_ns_ / 1e6 / frames);
+  }
+
+  report_start_ns_ = now;
+  frames_ = 0;
+  wait_ns_ = 0;
+  latency_samples_ = 0;
+  latency_sum_ns_ = 0;
+  latency_max_ns_ = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QVulkanFunctions>
+
+enum class PresentMode : quint8 { kFifo, kMailbox, kImmediate };
+
+const char* PresentModeName(PresentMode mode);
+VkPresentModeKHR ToVkPresentMode(PresentMode mode);
+
+// Bounds the frames QVulkanWindow keeps in flight and, in low-latency mode,
+// delays the start of the next frame so that input is sampled as late as the
+// predicted present allows. QVulkanWindow does not expose its own fences, so
+// after every frameReady() an empty batch carrying one of ours is submitted
+// to the same queue: it signals once everything submitted before it is done.
+class FramePacer {
+ public:
+  struct Options {
+    int frames_in_flight{2};
+    PresentMode present_mode{PresentMode::kFifo};
+    bool low_latency{false};
+  };
+
+  void SetOptions(const Options& options) noexcept { options_ = options; }
+  const Options& options() const noexcept { return options_; }
+
+  // `max_frames_in_flight` is what the window allows, the configured value is
+  // clamped to it.
+  void Init(VkDevice device,
+            QVulkanDeviceFunctions* device_functions,
+            VkQueue queue,
+            int max_frames_in_flight) noexcept;
+  void Release() noexcept;
+
+  // Sets the display refresh interval the pacing aims at.
+  void SetRefreshRate(qreal hz) noexcept;
+
+  // Call first thing in startNextFrame(): waits until fewer than
+  // frames_in_flight frames are still executing.
+  void BeginFrame() noexcept;
+  // Call right after frameReady(). Returns how long to wait before requesting
+  // the next frame, 0 unless pacing for low latency.
+  int EndFrame() noexcept;
+
+  // Timestamps user input; the next frame started is the one that shows it.
+  // Its input-to-render-complete latency is taken when that frame's fence is
+  // seen signaled. The wait in the FIFO present queue and the scanout that
+  // follow are not included: QVulkanWindow does not expose its swapchain for
+  // VK_KHR_present_wait or VK_GOOGLE_display_timing.
+  void OnInput() noexcept;
+
+ private:
+  struct Slot {
+    VkFence fence{VK_NULL_HANDLE};
+    bool submitted{false};
+    qint64 started_ns{};
+    qint64 input_ns{};  // 0: no input in this frame
+  };
+
+  static constexpr int kMaxSlots{4};
+
+  // Waits for `slot` (or only polls it when `wait` is false) and takes its
+  // latency sample once it is done. Returns false if it is still running.
+  bool Retire(Slot* slot, bool wait);
+  void MaybeReport();
+
+  Options options_;
+  VkDevice device_{VK_NULL_HANDLE};
+  QVulkanDeviceFunctions* device_functions_{};
+  VkQueue queue_{VK_NULL_HANDLE};
+  Slot slots_[kMaxSlots];
+  int slot_count_{};
+  int current_{};
+
+  QElapsedTimer clock_;
+  qint64 refresh_ns_{16'666'667};
+  qint64 pending_input_ns_{};
+  qint64 work_ns_{};  // moving average, frame start to GPU done
+
+  // Accumulated since the last report.
+  qint64 report_start_ns_{};
+  int frames_{};
+  qint64 wait_ns_{};
+  int latency_samples_{};
+  qint64 latency_sum_ns_{};
+  qint64 latency_max_ns_{};
+};
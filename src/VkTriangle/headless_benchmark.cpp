@@ -0,0 +1,751 @@
+#include "headless_benchmark.h"
+
+#include <vector>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtGui/QVulkanFunctions>
+
+#include "tracing.h"
+
+namespace {
+constexpr VkFormat kColorFormat{VK_FORMAT_R8G8B8A8_UNORM};
+
+// Same as QVulkanWindow::clipCorrectionMatrix(), which needs a window.
+QMatrix4x4 ClipCorrectionMatrix() {
+  return QMatrix4x4(1.0f, 0.0f, 0.0f, 0.0f,   //
+                    0.0f, -1.0f, 0.0f, 0.0f,  //
+                    0.0f, 0.0f, 0.5f, 0.5f,   //
+                    0.0f, 0.0f, 0.0f, 1.0f);
+}
+}  // namespace
+
+HeadlessBenchmark::HeadlessBenchmark(QVulkanInstance* instance,
+                                     const Options& options) noexcept
+    : instance_(instance), options_(options) {
+  options_.frames_in_flight = qBound(
+      1, options_.frames_in_flight, TriangleScene::kMaxConcurrentFrameCount);
+}
+
+HeadlessBenchmark::~HeadlessBenchmark() {
+  Release();
+}
+
+int HeadlessBenchmark::Run() noexcept {
+  if (!CreateDevice() || !CreateRenderTarget() || !CreateFrames()) {
+    Release();
+    return EXIT_FAILURE;
+  }
+
+  timer_.start();
+  scene_.SetObjectCount(options_.objects);
+  scene_.SetDrawPath(options_.draw_path < 0 ? DrawPath::kDynamicUniform
+                                            : DrawPath(options_.draw_path));
+  scene_.InitResources({.device = device_,
+                        .device_functions = device_functions_,
+                        .limits = &properties_.limits,
+                        .memory_properties = &memory_properties_,
+                        .host_visible_memory_index = FindMemoryType(
+                            ~0U, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+                        .render_pass = render_pass_,
+                        .sample_count = sample_count_,
+                        .concurrent_frame_count = options_.frames_in_flight});
+  scene_initialized_ = true;
+  scene_.Resize(options_.size, ClipCorrectionMatrix());
+  if (options_.variants) {
+    scene_.PrewarmVariants();
+  }
+
+  const bool simulating = options_.simulation != SimulationMode::kOff;
+  if (simulating) {
+    simulation_.Init({.device = device_,
+                      .device_functions = device_functions_,
+                      .limits = &properties_.limits,
+                      .memory_properties = &memory_properties_,
+                      .graphics_queue = queue_,
+                      .graphics_family = queue_family_index_,
+                      .graphics_timestamp_bits = timestamp_valid_bits_,
+                      .compute_queue = compute_queue_,
+                      .compute_family = compute_family_index_,
+                      .compute_timestamp_bits = compute_timestamp_valid_bits_,
+                      .instance = instance_,
+                      .calibrated_timestamps = calibrated_timestamps_,
+                      .object_set_layout = scene_.storage_set_layout(),
+                      .object_count = scene_.object_count(),
+                      .concurrent_frame_count = options_.frames_in_flight});
+    simulation_initialized_ = true;
+  }
+
+  qInfo("  frames           = %d (%d in flight, %dx MSAA, %dx%d)",
+        options_.frames, options_.frames_in_flight, int(sample_count_),
+        options_.size.width(), options_.size.height());
+  qInfo("  objects          = %d", scene_.object_count());
+
+  // Same scene, one run per draw path, so the paths can be compared.
+  QJsonArray runs;
+  for (int path = 0; path < kDrawPathCount; ++path) {
+    if (options_.draw_path >= 0 && path != options_.draw_path) {
+      continue;
+    }
+    // Simulated matrices are only drawn through the SSBO path.
+    if (simulating && DrawPath(path) != DrawPath::kStorageBuffer) {
+      continue;
+    }
+    scene_.SetDrawPath(DrawPath(path));
+    QJsonObject run;
+    const bool ok = suite_.Run(options_.bench, [this, &run] {
+      if (!RunFrames()) {
+        return false;
+      }
+      run = Report();
+      suite_.AddJson(DrawPathName(scene_.draw_path()), run);
+      return true;
+    });
+    if (!ok) {
+      Release();
+      return EXIT_FAILURE;
+    }
+    runs.append(run);
+  }
+  if (options_.variants) {
+    scene_.pipelines()->Report();
+  }
+  suite_.Log();
+  WriteJson(runs);
+
+  Release();
+  return EXIT_SUCCESS;
+}
+
+bool HeadlessBenchmark::RunFrames() {
+  const int frames_in_flight = options_.frames_in_flight;
+  qint64 wall_start{};
+  const int total_frames = options_.warmup_frames + options_.frames;
+  for (int i = 0; i < total_frames; ++i) {
+    if (i == options_.warmup_frames) {
+      stats_ = {};
+      simulation_.ResetStats();
+      wall_start = timer_.nsecsElapsed();
+    }
+
+    TRACE_SCOPE("vulkan", "HeadlessFrame");
+    const int slot = i % frames_in_flight;
+    Frame& frame = frames_[slot];
+
+    // Waiting here is what bounds the number of frames in flight.
+    const qint64 wait_start = timer_.nsecsElapsed();
+    device_functions_->vkWaitForFences(device_, 1, &frame.fence, VK_TRUE,
+                                       UINT64_MAX);
+    const qint64 wait_end = timer_.nsecsElapsed();
+    CollectGpuTime(slot);
+    device_functions_->vkResetFences(device_, 1, &frame.fence);
+
+    const qint64 record_start = timer_.nsecsElapsed();
+    VkCommandBufferBeginInfo begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    VkCommandBuffer cb = frame.command_buffer;
+    device_functions_->vkBeginCommandBuffer(cb, &begin_info);
+    if (query_pool_) {
+      device_functions_->vkCmdResetQueryPool(cb, query_pool_, slot * 2, 2);
+      device_functions_->vkCmdWriteTimestamp(
+          cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_, slot * 2);
+    }
+    if (options_.variants) {
+      constexpr int kFeatureCount = kShaderFeatureAll + 1;
+      scene_.SetVariant(BlendMode(i / kFeatureCount % 3), i % kFeatureCount);
+    }
+    const VkDescriptorSet object_set =
+        simulation_initialized_
+            ? simulation_.BeginFrame({.projection = scene_.projection(),
+                                      .rotation = scene_.rotation(),
+                                      .grid_columns = scene_.grid_columns()})
+            : VK_NULL_HANDLE;
+    const bool variant_ready =
+        scene_.Record(cb, frame.framebuffer, slot, object_set);
+    if (query_pool_) {
+      device_functions_->vkCmdWriteTimestamp(
+          cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_, slot * 2 + 1);
+    }
+    device_functions_->vkEndCommandBuffer(cb);
+    const qint64 record_end = timer_.nsecsElapsed();
+
+    VkSubmitInfo submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                             .commandBufferCount = 1,
+                             .pCommandBuffers = &cb};
+    VkResult err =
+        device_functions_->vkQueueSubmit(queue_, 1, &submit_info, frame.fence);
+    if (err != VK_SUCCESS) {
+      qCritical("Failed to submit frame %d: %d", i, err);
+      return false;
+    }
+    if (simulation_initialized_) {
+      simulation_.EndFrame({.projection = scene_.projection(),
+                            .rotation = scene_.rotation(),
+                            .grid_columns = scene_.grid_columns()});
+    }
+
+    if (!first_frame_ns_) {
+      first_frame_ns_ = timer_.nsecsElapsed();
+      qInfo("  first frame ms   = %.2f (submitted)", first_frame_ns_ / 1e6);
+    }
+
+    frame.measured = i >= options_.warmup_frames;
+    if (frame.measured) {
+      ++stats_.frames;
+      stats_.fallback_frames += variant_ready ? 0 : 1;
+      stats_.wait_ns += wait_end - wait_start;
+      stats_.record_ns += record_end - record_start;
+    }
+  }
+  device_functions_->vkDeviceWaitIdle(device_);
+  stats_.wall_ns = timer_.nsecsElapsed() - wall_start;
+  for (int slot = 0; slot < frames_in_flight; ++slot) {
+    CollectGpuTime(slot);
+  }
+  return true;
+}
+
+bool HeadlessBenchmark::CreateDevice() {
+  QVulkanFunctions* f = instance_->functions();
+  uint32_t physical_device_count{};
+  f->vkEnumeratePhysicalDevices(instance_->vkInstance(),
+                                &physical_device_count, nullptr);
+  std::vector<VkPhysicalDevice> physical_devices(physical_device_count);
+  f->vkEnumeratePhysicalDevices(instance_->vkInstance(),
+                                &physical_device_count,
+                                physical_devices.data());
+
+  // First device with a graphics queue wins; on a GPU-less box that is
+  // lavapipe.
+  for (VkPhysicalDevice physical_device : physical_devices) {
+    uint32_t family_count{};
+    f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device,
+                                                &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    f->vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, families.data());
+    for (uint32_t i = 0; i < family_count; ++i) {
+      if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        physical_device_ = physical_device;
+        queue_family_index_ = i;
+        timestamp_valid_bits_ = families[i].timestampValidBits;
+        break;
+      }
+    }
+    if (physical_device_) {
+      break;
+    }
+  }
+  if (!physical_device_) {
+    qCritical("No Vulkan device with a graphics queue found");
+    return false;
+  }
+  f->vkGetPhysicalDeviceProperties(physical_device_, &properties_);
+  f->vkGetPhysicalDeviceMemoryProperties(physical_device_,
+                                         &memory_properties_);
+  qInfo("Headless benchmark on %s", properties_.deviceName);
+
+  compute_family_index_ = queue_family_index_;
+  compute_timestamp_valid_bits_ = timestamp_valid_bits_;
+  if (options_.simulation == SimulationMode::kAsync) {
+    uint32_t family_count{};
+    f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device_,
+                                                &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    f->vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device_, &family_count, families.data());
+    for (uint32_t i = 0; i < family_count; ++i) {
+      if ((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+          !(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+        compute_family_index_ = i;
+        compute_timestamp_valid_bits_ = families[i].timestampValidBits;
+        break;
+      }
+    }
+    if (compute_family_index_ == queue_family_index_) {
+      qWarning("No compute-only queue family, simulating on the graphics "
+               "queue");
+    }
+  }
+
+  // Makes the timestamps of the two queues comparable, for the overlap.
+  std::vector<const char*> extensions;
+  calibrated_timestamps_ =
+      options_.simulation != SimulationMode::kOff &&
+      SupportsTimestampCalibration(instance_, physical_device_);
+  if (calibrated_timestamps_) {
+    extensions.push_back(kTimestampCalibrationExtension);
+  }
+
+  const float priority{1.0f};
+  const VkDeviceQueueCreateInfo queue_infos[2] = {
+      {.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+       .queueFamilyIndex = queue_family_index_,
+       .queueCount = 1,
+       .pQueuePriorities = &priority},
+      {.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+       .queueFamilyIndex = compute_family_index_,
+       .queueCount = 1,
+       .pQueuePriorities = &priority}};
+  VkDeviceCreateInfo device_info{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .queueCreateInfoCount =
+          compute_family_index_ != queue_family_index_ ? 2U : 1U,
+      .pQueueCreateInfos = queue_infos,
+      .enabledExtensionCount = uint32_t(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data()};
+  VkResult err =
+      f->vkCreateDevice(physical_device_, &device_info, nullptr, &device_);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to create device: %d", err);
+    return false;
+  }
+  device_functions_ = instance_->deviceFunctions(device_);
+  device_functions_->vkGetDeviceQueue(device_, queue_family_index_, 0,
+                                      &queue_);
+  device_functions_->vkGetDeviceQueue(device_, compute_family_index_, 0,
+                                      &compute_queue_);
+
+  // Pick a depth-stencil format the same way QVulkanWindow does.
+  const VkFormat depth_formats[] = {VK_FORMAT_D24_UNORM_S8_UINT,
+                                    VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                    VK_FORMAT_D16_UNORM_S8_UINT};
+  for (VkFormat format : depth_formats) {
+    VkFormatProperties format_properties;
+    f->vkGetPhysicalDeviceFormatProperties(physical_device_, format,
+                                           &format_properties);
+    if (format_properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      depth_format_ = format;
+      break;
+    }
+  }
+  if (depth_format_ == VK_FORMAT_UNDEFINED) {
+    qCritical("No supported depth-stencil format");
+    return false;
+  }
+
+  const VkSampleCountFlags supported_samples =
+      properties_.limits.framebufferColorSampleCounts &
+      properties_.limits.framebufferDepthSampleCounts;
+  if (options_.sample_count > 1) {
+    if (supported_samples & options_.sample_count) {
+      sample_count_ = VkSampleCountFlagBits(options_.sample_count);
+    } else {
+      qWarning("Sample count %d not supported, not using MSAA",
+               options_.sample_count);
+    }
+  }
+  return true;
+}
+
+bool HeadlessBenchmark::CreateRenderTarget() {
+  // Attachment order matches QVulkanWindow::defaultRenderPass(): resolved
+  // color, depth-stencil, then the multisample color buffer if any, so
+  // TriangleScene's clear values line up with both.
+  const bool msaa = sample_count_ > VK_SAMPLE_COUNT_1_BIT;
+  VkAttachmentDescription attachments[3] = {
+      {.format = kColorFormat,
+       .samples = VK_SAMPLE_COUNT_1_BIT,
+       .loadOp = msaa ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
+                      : VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
+      {.format = depth_format_,
+       .samples = sample_count_,
+       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL},
+      {.format = kColorFormat,
+       .samples = sample_count_,
+       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+
+  VkAttachmentReference color_ref{
+      .attachment = msaa ? 2U : 0U,
+      .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depth_ref{
+      .attachment = 1,
+      .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference resolve_ref{
+      .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{
+      .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+      .colorAttachmentCount = 1,
+      .pColorAttachments = &color_ref,
+      .pResolveAttachments = msaa ? &resolve_ref : nullptr,
+      .pDepthStencilAttachment = &depth_ref};
+
+  // The depth (and multisample) buffer is shared by all frames in flight,
+  // like QVulkanWindow does, so order attachment writes between frames.
+  constexpr VkPipelineStageFlags kAttachmentStages =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  VkSubpassDependency dependency{
+      .srcSubpass = VK_SUBPASS_EXTERNAL,
+      .dstSubpass = 0,
+      .srcStageMask = kAttachmentStages,
+      .dstStageMask = kAttachmentStages,
+      .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+
+  VkRenderPassCreateInfo render_pass_info{
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+      .attachmentCount = msaa ? 3U : 2U,
+      .pAttachments = attachments,
+      .subpassCount = 1,
+      .pSubpasses = &subpass,
+      .dependencyCount = 1,
+      .pDependencies = &dependency};
+  VkResult err = device_functions_->vkCreateRenderPass(
+      device_, &render_pass_info, nullptr, &render_pass_);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to create render pass: %d", err);
+    return false;
+  }
+
+  if (!CreateImage(depth_format_,
+                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, sample_count_,
+                   VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                   &depth_)) {
+    return false;
+  }
+  if (msaa && !CreateImage(kColorFormat,
+                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                           sample_count_, VK_IMAGE_ASPECT_COLOR_BIT,
+                           &msaa_color_)) {
+    return false;
+  }
+  return true;
+}
+
+bool HeadlessBenchmark::CreateFrames() {
+  VkCommandPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queue_family_index_};
+  VkResult err = device_functions_->vkCreateCommandPool(device_, &pool_info,
+                                                        nullptr,
+                                                        &command_pool_);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to create command pool: %d", err);
+    return false;
+  }
+
+  // Two timestamps per frame slot: top and bottom of the frame. A queue
+  // without timestamp bits must not write any, its GPU time stays -1.
+  if (timestamp_valid_bits_) {
+    VkQueryPoolCreateInfo query_pool_info{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = uint32_t(options_.frames_in_flight * 2)};
+    err = device_functions_->vkCreateQueryPool(device_, &query_pool_info,
+                                               nullptr, &query_pool_);
+    if (err != VK_SUCCESS) {
+      qCritical("Failed to create query pool: %d", err);
+      return false;
+    }
+  } else {
+    qWarning("The queue has no timestamps, GPU time is not measured");
+  }
+
+  for (int i = 0; i < options_.frames_in_flight; ++i) {
+    Frame& frame = frames_[i];
+    // Like swapchain images, every frame in flight renders into its own
+    // color image.
+    if (!CreateImage(kColorFormat,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                     VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+                     &frame.color)) {
+      return false;
+    }
+
+    const VkImageView views[3] = {frame.color.view, depth_.view,
+                                  msaa_color_.view};
+    VkFramebufferCreateInfo framebuffer_info{
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = render_pass_,
+        .attachmentCount =
+            sample_count_ > VK_SAMPLE_COUNT_1_BIT ? 3U : 2U,
+        .pAttachments = views,
+        .width = uint32_t(options_.size.width()),
+        .height = uint32_t(options_.size.height()),
+        .layers = 1};
+    err = device_functions_->vkCreateFramebuffer(device_, &framebuffer_info,
+                                                 nullptr, &frame.framebuffer);
+    if (err != VK_SUCCESS) {
+      qCritical("Failed to create framebuffer: %d", err);
+      return false;
+    }
+
+    VkCommandBufferAllocateInfo cb_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool_,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
+    err = device_functions_->vkAllocateCommandBuffers(device_, &cb_info,
+                                                      &frame.command_buffer);
+    if (err != VK_SUCCESS) {
+      qCritical("Failed to allocate command buffer: %d", err);
+      return false;
+    }
+
+    // Signaled, so the first wait on every slot returns immediately.
+    VkFenceCreateInfo fence_info{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                                 .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+    err = device_functions_->vkCreateFence(device_, &fence_info, nullptr,
+                                           &frame.fence);
+    if (err != VK_SUCCESS) {
+      qCritical("Failed to create fence: %d", err);
+      return false;
+    }
+  }
+  return true;
+}
+
+void HeadlessBenchmark::Release() {
+  if (!device_) {
+    return;
+  }
+  device_functions_->vkDeviceWaitIdle(device_);
+
+  if (simulation_initialized_) {
+    simulation_.Release();
+    simulation_initialized_ = false;
+  }
+  if (scene_initialized_) {
+    scene_.ReleaseResources();
+    scene_initialized_ = false;
+  }
+
+  for (Frame& frame : frames_) {
+    if (frame.fence) {
+      device_functions_->vkDestroyFence(device_, frame.fence, nullptr);
+    }
+    if (frame.framebuffer) {
+      device_functions_->vkDestroyFramebuffer(device_, frame.framebuffer,
+                                              nullptr);
+    }
+    DestroyImage(&frame.color);
+    frame = {};
+  }
+  DestroyImage(&msaa_color_);
+  DestroyImage(&depth_);
+
+  if (render_pass_) {
+    device_functions_->vkDestroyRenderPass(device_, render_pass_, nullptr);
+    render_pass_ = VK_NULL_HANDLE;
+  }
+  if (query_pool_) {
+    device_functions_->vkDestroyQueryPool(device_, query_pool_, nullptr);
+    query_pool_ = VK_NULL_HANDLE;
+  }
+  if (command_pool_) {
+    // Frees the command buffers as well.
+    device_functions_->vkDestroyCommandPool(device_, command_pool_, nullptr);
+    command_pool_ = VK_NULL_HANDLE;
+  }
+
+  device_functions_->vkDestroyDevice(device_, nullptr);
+  instance_->resetDeviceFunctions(device_);
+  device_ = VK_NULL_HANDLE;
+  device_functions_ = nullptr;
+}
+
+bool HeadlessBenchmark::CreateImage(VkFormat format,
+                                    VkImageUsageFlags usage,
+                                    VkSampleCountFlagBits samples,
+                                    VkImageAspectFlags aspect,
+                                    Image* image) {
+  VkImageCreateInfo image_info{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = format,
+      .extent = {.width = uint32_t(options_.size.width()),
+                 .height = uint32_t(options_.size.height()),
+                 .depth = 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = samples,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+  VkResult err = device_functions_->vkCreateImage(device_, &image_info,
+                                                  nullptr, &image->image);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to create image: %d", err);
+    return false;
+  }
+
+  VkMemoryRequirements mem_req;
+  device_functions_->vkGetImageMemoryRequirements(device_, image->image,
+                                                  &mem_req);
+  VkMemoryAllocateInfo mem_alloc_info{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, mem_req.size,
+      FindMemoryType(mem_req.memoryTypeBits,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+  err = device_functions_->vkAllocateMemory(device_, &mem_alloc_info, nullptr,
+                                            &image->memory);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to allocate image memory: %d", err);
+    return false;
+  }
+  err = device_functions_->vkBindImageMemory(device_, image->image,
+                                             image->memory, 0);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to bind image memory: %d", err);
+    return false;
+  }
+
+  VkImageViewCreateInfo view_info{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = image->image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = format,
+      .subresourceRange = {.aspectMask = aspect,
+                           .baseMipLevel = 0,
+                           .levelCount = 1,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1}};
+  err = device_functions_->vkCreateImageView(device_, &view_info, nullptr,
+                                             &image->view);
+  if (err != VK_SUCCESS) {
+    qCritical("Failed to create image view: %d", err);
+    return false;
+  }
+  return true;
+}
+
+void HeadlessBenchmark::DestroyImage(Image* image) {
+  if (image->view) {
+    device_functions_->vkDestroyImageView(device_, image->view, nullptr);
+  }
+  if (image->image) {
+    device_functions_->vkDestroyImage(device_, image->image, nullptr);
+  }
+  if (image->memory) {
+    device_functions_->vkFreeMemory(device_, image->memory, nullptr);
+  }
+  *image = {};
+}
+
+uint32_t HeadlessBenchmark::FindMemoryType(uint32_t type_bits,
+                                           VkMemoryPropertyFlags flags) const {
+  for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i) {
+    if ((type_bits & (1U << i)) &&
+        (memory_properties_.memoryTypes[i].propertyFlags & flags) == flags) {
+      return i;
+    }
+  }
+  // Software implementations expose a single type that is everything at
+  // once; anything else is a broken driver.
+  qWarning("No memory type with flags 0x%x, using type 0", flags);
+  return 0;
+}
+
+void HeadlessBenchmark::CollectGpuTime(int slot) {
+  Frame& frame = frames_[slot];
+  if (!frame.measured) {
+    return;
+  }
+  frame.measured = false;
+  if (!query_pool_) {
+    return;
+  }
+
+  quint64 timestamps[2]{};
+  VkResult err = device_functions_->vkGetQueryPoolResults(
+      device_, query_pool_, slot * 2, 2, sizeof(timestamps), timestamps,
+      sizeof(quint64), VK_QUERY_RESULT_64_BIT);
+  if (err != VK_SUCCESS) {
+    return;
+  }
+  const quint64 mask = timestamp_valid_bits_ >= 64
+                           ? ~0ULL
+                           : (1ULL << timestamp_valid_bits_) - 1;
+  const quint64 ticks = (timestamps[1] & mask) - (timestamps[0] & mask);
+  stats_.gpu_ns += double(ticks & mask) * properties_.limits.timestampPeriod;
+  ++stats_.gpu_frames;
+}
+
+QJsonObject HeadlessBenchmark::Report() const {
+  const int frames = qMax(stats_.frames, 1);
+  const int draws = scene_.object_count();
+  const double seconds = stats_.wall_ns / 1e9;
+  const double fps = seconds > 0 ? stats_.frames / seconds : 0;
+  const double record_us = stats_.record_ns / 1e3 / frames;
+  const double wait_us = stats_.wait_ns / 1e3 / frames;
+  const double gpu_us =
+      stats_.gpu_frames ? stats_.gpu_ns / 1e3 / stats_.gpu_frames : -1;
+
+  qInfo("  [%s]", DrawPathName(scene_.draw_path()));
+  qInfo("    frames/s       = %.1f", fps);
+  qInfo("    cpu record us  = %.2f (%.3f per draw)", record_us,
+        record_us / draws);
+  qInfo("    cpu wait us    = %.2f", wait_us);
+  if (gpu_us >= 0) {
+    qInfo("    gpu us         = %.2f (%.3f per draw)", gpu_us, gpu_us / draws);
+  } else {
+    qInfo("    gpu us         = n/a (no timestamp support)");
+  }
+  if (options_.variants) {
+    qInfo("    fallback frames = %d", stats_.fallback_frames);
+  }
+
+  QJsonObject run{{"draw_path", DrawPathName(scene_.draw_path())},
+                  {"frames", stats_.frames},
+                  {"fallback_frames", stats_.fallback_frames},
+                  {"fps", fps},
+                  {"cpu_record_us", record_us},
+                  {"cpu_record_us_per_draw", record_us / draws},
+                  {"cpu_wait_us", wait_us},
+                  {"gpu_us", gpu_us},
+                  {"gpu_us_per_draw", gpu_us >= 0 ? gpu_us / draws : -1}};
+  if (simulation_initialized_) {
+    run.insert("simulation", simulation_.Report());
+  }
+  return run;
+}
+
+void HeadlessBenchmark::WriteJson(const QJsonArray& runs) const {
+  if (options_.json_path.isEmpty()) {
+    return;
+  }
+  QJsonObject json{{"benchmark", "VkTriangle.headless"},
+                   {"device", properties_.deviceName},
+                   {"frames_in_flight", options_.frames_in_flight},
+                   {"sample_count", int(sample_count_)},
+                   {"objects", scene_.object_count()},
+                   {"simulation", SimulationModeName(options_.simulation)},
+                   {"first_frame_ms", first_frame_ns_ / 1e6},
+                   {"runs", runs},
+                   {"bench", suite_.ToJson()}};
+  QFile file(options_.json_path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning("Failed to write %s", qPrintable(options_.json_path));
+    return;
+  }
+  file.write(QJsonDocument(json).toJson());
+}
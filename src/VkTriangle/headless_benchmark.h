@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QVulkanInstance>
+
+#include "bench.h"
+#include "transform_simulation.h"
+#include "triangle_scene.h"
+
+// Drives TriangleScene without QVulkanWindow: creates its own device,
+// offscreen color/depth images and render pass, then records and submits
+// frames as fast as the device allows with a fixed number in flight. Nothing
+// is presented, so the numbers are not capped by the display.
+class HeadlessBenchmark {
+ public:
+  struct Options {
+    int frames{1000};
+    int warmup_frames{60};
+    int frames_in_flight{2};
+    int sample_count{1};
+    QSize size{1024, 768};
+    int objects{1};
+    int draw_path{-1};  // DrawPath to measure, -1: each one in turn
+    // Prewarm every pipeline variant and draw a different one each frame.
+    bool variants{false};
+    // Compute the matrices with TransformSimulation (SSBO path only).
+    SimulationMode simulation{SimulationMode::kOff};
+    // Whole runs of `frames` per draw path, summarized in the JSON file.
+    bench::Options bench;
+    QString json_path;  // empty: table only
+  };
+
+  HeadlessBenchmark(QVulkanInstance* instance, const Options& options) noexcept;
+  ~HeadlessBenchmark();
+
+  // Returns EXIT_SUCCESS, or EXIT_FAILURE when no usable device was found.
+  int Run() noexcept;
+
+ private:
+  struct Image {
+    VkImage image{VK_NULL_HANDLE};
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkImageView view{VK_NULL_HANDLE};
+  };
+
+  struct Frame {
+    Image color;
+    VkFramebuffer framebuffer{VK_NULL_HANDLE};
+    VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+    VkFence fence{VK_NULL_HANDLE};
+    bool measured{false};  // submitted after warmup, GPU time not read yet
+  };
+
+  struct Stats {
+    int frames{};
+    qint64 wall_ns{};
+    qint64 record_ns{};
+    qint64 wait_ns{};
+    double gpu_ns{};
+    int gpu_frames{};
+    int fallback_frames{};
+  };
+
+  bool CreateDevice();
+  bool CreateRenderTarget();
+  bool CreateFrames();
+  void Release();
+
+  // Renders warmup plus measured frames, filling stats_.
+  bool RunFrames();
+
+  bool CreateImage(VkFormat format,
+                   VkImageUsageFlags usage,
+                   VkSampleCountFlagBits samples,
+                   VkImageAspectFlags aspect,
+                   Image* image);
+  void DestroyImage(Image* image);
+  uint32_t FindMemoryType(uint32_t type_bits,
+                          VkMemoryPropertyFlags flags) const;
+
+  void CollectGpuTime(int slot);
+  // Logs stats_ of the current draw path and returns them for the JSON file.
+  QJsonObject Report() const;
+  void WriteJson(const QJsonArray& runs) const;
+
+  QVulkanInstance* instance_;
+  Options options_;
+
+  VkPhysicalDevice physical_device_{VK_NULL_HANDLE};
+  VkPhysicalDeviceProperties properties_{};
+  VkPhysicalDeviceMemoryProperties memory_properties_{};
+  uint32_t queue_family_index_{};
+  uint32_t timestamp_valid_bits_{};
+
+  VkDevice device_{VK_NULL_HANDLE};
+  QVulkanDeviceFunctions* device_functions_{};
+  VkQueue queue_{VK_NULL_HANDLE};
+  // Same as the graphics queue unless simulating on an async compute queue.
+  VkQueue compute_queue_{VK_NULL_HANDLE};
+  uint32_t compute_family_index_{};
+  uint32_t compute_timestamp_valid_bits_{};
+  bool calibrated_timestamps_{false};  // kTimestampCalibrationExtension on
+  VkCommandPool command_pool_{VK_NULL_HANDLE};
+  VkQueryPool query_pool_{VK_NULL_HANDLE};
+
+  VkSampleCountFlagBits sample_count_{VK_SAMPLE_COUNT_1_BIT};
+  VkFormat depth_format_{VK_FORMAT_UNDEFINED};
+  VkRenderPass render_pass_{VK_NULL_HANDLE};
+  Image depth_;
+  Image msaa_color_;
+  Frame frames_[TriangleScene::kMaxConcurrentFrameCount];
+
+  TriangleScene scene_;
+  bool scene_initialized_{false};
+  TransformSimulation simulation_;
+  bool simulation_initialized_{false};
+  QElapsedTimer timer_;
+  qint64 first_frame_ns_{};
+  Stats stats_;
+  bench::Suite suite_{"VkTriangle.headless"};
+};
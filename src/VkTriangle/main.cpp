@@ -1,16 +1,103 @@
 // https://doc.qt.io/archives/qt-5.15/qtgui-hellovulkantriangle-example.html
 // vcpkg install qt5-base[vulkan] --recurse
 
+#include <cstring>
+#include <optional>
+
+#include <QtCore/QCommandLineParser>
 #include <QtCore/QLoggingCategory>
 #include <QtGui/QGuiApplication>
 #include <QtGui/QVulkanInstance>
 
+#include "bench.h"
+#include "headless_benchmark.h"
+#include "tracing.h"
 #include "vk_triangle_window.h"
 
 Q_LOGGING_CATEGORY(lcVk, "qt.vulkan")
 
 int main(int argc, char* argv[]) {
+  // Headless runs must not need a display, so pick the offscreen platform
+  // before QGuiApplication looks for one.
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "--headless") &&
+        qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+  }
+
   QGuiApplication app(argc, argv);
+  tracing::StartFromEnvironment();
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  const QCommandLineOption headless_option(
+      "headless", "Render offscreen as fast as possible and report timings.");
+  const QCommandLineOption frames_option("frames", "Frames to measure.",
+                                         "n", "1000");
+  const QCommandLineOption in_flight_option(
+      "frames-in-flight", "Frames in flight.", "k", "2");
+  const QCommandLineOption samples_option(
+      "samples", "MSAA sample count (headless).", "n", "1");
+  const QCommandLineOption variants_option(
+      "variants",
+      "Compile all pipeline variants in the background and switch every "
+      "frame (headless).");
+  const QCommandLineOption objects_option(
+      "objects", "Triangles drawn per frame, one draw call each.", "n", "1");
+  const QCommandLineOption draw_path_option(
+      "draw-path",
+      "How per-object matrices are passed: push, ubo, ssbo, or all to "
+      "compare them one after another (headless).",
+      "path", "all");
+  const QCommandLineOption present_mode_option(
+      "present-mode", "Preferred present mode: fifo, mailbox or immediate.",
+      "mode", "fifo");
+  const QCommandLineOption low_latency_option(
+      "low-latency",
+      "Delay each frame to just before the predicted present, trading "
+      "throughput for input latency (window).");
+  const QCommandLineOption simulation_option(
+      "simulation",
+      "Compute the matrices in a compute pass: off, serial (graphics queue) "
+      "or async (separate compute queue, overlapping the previous frame).",
+      "mode", "off");
+  const QCommandLineOption json_option(
+      "json", "Write headless results as JSON to <file>.", "file");
+  parser.addOptions({headless_option, frames_option, in_flight_option,
+                     samples_option, variants_option, objects_option,
+                     draw_path_option, present_mode_option,
+                     low_latency_option, simulation_option, json_option});
+  bench::AddOptions(&parser);
+  parser.process(app);
+
+  // A typo would silently benchmark without the simulation.
+  std::optional<SimulationMode> simulation;
+  for (SimulationMode mode : {SimulationMode::kOff, SimulationMode::kSerial,
+                              SimulationMode::kAsync}) {
+    if (parser.value(simulation_option) == SimulationModeName(mode)) {
+      simulation = mode;
+    }
+  }
+  if (!simulation) {
+    qCritical("Unknown simulation mode %s, expected off, serial or async",
+              qPrintable(parser.value(simulation_option)));
+    return EXIT_FAILURE;
+  }
+
+  // A typo would silently fall back to fifo and look like a driver issue.
+  std::optional<PresentMode> present_mode;
+  for (PresentMode mode :
+       {PresentMode::kFifo, PresentMode::kMailbox, PresentMode::kImmediate}) {
+    if (parser.value(present_mode_option) == PresentModeName(mode)) {
+      present_mode = mode;
+    }
+  }
+  if (!present_mode) {
+    qCritical("Unknown present mode %s, expected fifo, mailbox or immediate",
+              qPrintable(parser.value(present_mode_option)));
+    return EXIT_FAILURE;
+  }
 
   QLoggingCategory::setFilterRules(QStringLiteral("qt.vulkan=true"));
 
@@ -31,8 +118,41 @@ int main(int argc, char* argv[]) {
   if (!inst.create())
     qFatal("Failed to create Vulkan instance: %d", inst.errorCode());
 
+  if (parser.isSet(headless_option)) {
+    HeadlessBenchmark::Options options;
+    options.frames = parser.value(frames_option).toInt();
+    options.frames_in_flight = parser.value(in_flight_option).toInt();
+    options.sample_count = parser.value(samples_option).toInt();
+    options.objects = parser.value(objects_option).toInt();
+    // -1 means all of them, so a typo must not end up there.
+    const QString draw_path = parser.value(draw_path_option);
+    options.draw_path = -1;
+    for (int path = 0; path < kDrawPathCount; ++path) {
+      if (draw_path == DrawPathName(DrawPath(path))) {
+        options.draw_path = path;
+      }
+    }
+    if (options.draw_path < 0 && draw_path != "all") {
+      qCritical("Unknown draw path %s, expected all, push, ubo or ssbo",
+                qPrintable(draw_path));
+      return EXIT_FAILURE;
+    }
+    options.variants = parser.isSet(variants_option);
+    options.simulation = *simulation;
+    options.bench = bench::ParseOptions(parser);
+    options.json_path = parser.value(json_option);
+    return HeadlessBenchmark(&inst, options).Run();
+  }
+
   VkTriangleWindow w;
   w.setVulkanInstance(&inst);
+  w.SetObjectCount(parser.value(objects_option).toInt());
+  FramePacer::Options pacing;
+  pacing.frames_in_flight = parser.value(in_flight_option).toInt();
+  pacing.present_mode = *present_mode;
+  pacing.low_latency = parser.isSet(low_latency_option);
+  w.SetFramePacing(pacing);
+  w.SetSimulation(*simulation);
 
   w.resize(1024, 768);
   w.show();
@@ -0,0 +1,356 @@
+#include "pipeline_library.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+#include "tracing.h"
+
+namespace {
+// Matches the layout of the specialization constants in color.frag.
+struct SpecializationData {
+  quint32 features;
+  float alpha;
+};
+
+const char* BlendModeName(BlendMode blend) {
+  switch (blend) {
+    case BlendMode::kOpaque:
+      return "opaque";
+    case BlendMode::kAlpha:
+      return "alpha";
+    case BlendMode::kAdditive:
+      return "additive";
+  }
+  return "?";
+}
+}  // namespace
+
+const char* DrawPathName(DrawPath path) {
+  switch (path) {
+    case DrawPath::kPushConstants:
+      return "push";
+    case DrawPath::kDynamicUniform:
+      return "ubo";
+    case DrawPath::kStorageBuffer:
+      return "ssbo";
+  }
+  return "?";
+}
+
+PipelineLibrary::PipelineLibrary() {
+  // Leave a core to the thread that records frames.
+  thread_pool_.setMaxThreadCount(
+      std::max(1, QThread::idealThreadCount() - 1));
+}
+
+void PipelineLibrary::Init(const Context& context,
+                           const PipelineKey& fallback) noexcept {
+  context_ = context;
+  fallback_key_ = fallback;
+  clock_.start();
+
+  QMutexLocker locker(&mutex_);
+  if (!Fallback(fallback.draw_path)) {
+    qFatal("Failed to create fallback graphics pipeline");
+  }
+}
+
+void PipelineLibrary::Release() noexcept {
+  // Variants still queued are dropped rather than compiled for nothing; their
+  // entries never get a pipeline.
+  thread_pool_.clear();
+  thread_pool_.waitForDone();
+
+  QMutexLocker locker(&mutex_);
+  for (const Entry& entry : std::as_const(entries_)) {
+    if (entry.pipeline && !entry.fallback) {
+      context_.device_functions->vkDestroyPipeline(context_.device,
+                                                   entry.pipeline, nullptr);
+    }
+  }
+  entries_.clear();
+  for (VkPipeline& fallback : fallbacks_) {
+    if (fallback) {
+      context_.device_functions->vkDestroyPipeline(context_.device, fallback,
+                                                   nullptr);
+      fallback = VK_NULL_HANDLE;
+    }
+  }
+  pending_ = 0;
+}
+
+VkPipeline PipelineLibrary::Get(const PipelineKey& key, bool* ready) noexcept {
+  QMutexLocker locker(&mutex_);
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  auto it = entries_.constFind(key);
+  if (it != entries_.constEnd()) {
+    if (it->ready) {
+      pipeline = it->pipeline;
+    }
+  } else if (key == FallbackKey(key.draw_path)) {
+    // Compiling it again on a worker would only duplicate the fallback.
+    pipeline = Fallback(key.draw_path);
+    Entry& entry = entries_[key];
+    entry.pipeline = pipeline;
+    entry.ready = pipeline != VK_NULL_HANDLE;
+    entry.fallback = true;
+  } else {
+    Queue(key);
+  }
+
+  if (ready) {
+    *ready = pipeline != VK_NULL_HANDLE;
+  }
+  return pipeline ? pipeline : Fallback(key.draw_path);
+}
+
+void PipelineLibrary::Prewarm(const QList<PipelineKey>& keys) noexcept {
+  QMutexLocker locker(&mutex_);
+  for (const PipelineKey& key : keys) {
+    // Fallbacks are compiled by Get() when their path is first drawn.
+    if (key != FallbackKey(key.draw_path) && !entries_.contains(key)) {
+      Queue(key);
+    }
+  }
+}
+
+bool PipelineLibrary::Idle() noexcept {
+  QMutexLocker locker(&mutex_);
+  return pending_ == 0;
+}
+
+void PipelineLibrary::Report() noexcept {
+  QMutexLocker locker(&mutex_);
+  std::vector<qint64> compile_ns;
+  qint64 last_finished_ns{};
+  qInfo("Pipeline variants: %lld (%d pending)", qint64(entries_.size()),
+        pending_);
+  for (int i = 0; i < kDrawPathCount; ++i) {
+    if (fallbacks_[i]) {
+      qInfo("  %-4s fallback: compile %7.2f ms (synchronous)",
+            DrawPathName(DrawPath(i)), fallback_compile_ns_[i] / 1e6);
+    }
+  }
+  for (auto it = entries_.cbegin(); it != entries_.cend(); ++it) {
+    const PipelineKey& key = it.key();
+    const Entry& entry = it.value();
+    if (!entry.ready || entry.fallback) {
+      continue;
+    }
+    const qint64 compile = entry.finished_ns - entry.started_ns;
+    compile_ns.push_back(compile);
+    last_finished_ns = std::max(last_finished_ns, entry.finished_ns);
+    qInfo("  %-4s %dx %-8s features 0x%x: queued %7.2f ms, compile %7.2f ms",
+          DrawPathName(key.draw_path), int(key.sample_count),
+          BlendModeName(key.blend), key.features,
+          (entry.started_ns - entry.queued_ns) / 1e6, compile / 1e6);
+  }
+  if (compile_ns.empty()) {
+    return;
+  }
+  std::sort(compile_ns.begin(), compile_ns.end());
+  qint64 total{};
+  for (qint64 ns : compile_ns) {
+    total += ns;
+  }
+  qInfo("  compile min/median/max %.2f/%.2f/%.2f ms, sum %.2f ms, "
+        "all done after %.2f ms on %d threads",
+        compile_ns.front() / 1e6, compile_ns[compile_ns.size() / 2] / 1e6,
+        compile_ns.back() / 1e6, total / 1e6, last_finished_ns / 1e6,
+        thread_pool_.maxThreadCount());
+}
+
+void PipelineLibrary::Queue(const PipelineKey& key) {
+  Entry& entry = entries_[key];
+  entry.queued_ns = clock_.nsecsElapsed();
+  ++pending_;
+  // Arrow from the frame that asked for the variant to its compile.
+  TRACE_FLOW_BEGIN("vulkan", "QueuePipeline", qHash(key));
+  thread_pool_.start([this, key] { Compile(key); });
+}
+
+VkPipeline PipelineLibrary::Fallback(DrawPath draw_path) {
+  // Pipelines only work with descriptors and push constants of their own
+  // layout, so each draw path needs its own fallback. It is created on the
+  // calling thread the first time the path is drawn.
+  VkPipeline& fallback = fallbacks_[int(draw_path)];
+  if (!fallback) {
+    TRACE_SCOPE("vulkan", "CreateFallbackPipeline");
+    const qint64 started_ns = clock_.nsecsElapsed();
+    fallback = CreatePipeline(FallbackKey(draw_path));
+    fallback_compile_ns_[int(draw_path)] = clock_.nsecsElapsed() - started_ns;
+  }
+  return fallback;
+}
+
+void PipelineLibrary::Compile(const PipelineKey& key) {
+  TRACE_SCOPE("vulkan", "CompilePipeline");
+  TRACE_FLOW_END("vulkan", "QueuePipeline", qHash(key));
+  const qint64 started_ns = clock_.nsecsElapsed();
+  VkPipeline pipeline = CreatePipeline(key);
+  const qint64 finished_ns = clock_.nsecsElapsed();
+  if (!pipeline) {
+    qWarning("Failed to create pipeline variant, keeping the fallback");
+  }
+
+  QMutexLocker locker(&mutex_);
+  Entry& entry = entries_[key];
+  entry.pipeline = pipeline;
+  entry.ready = true;
+  entry.started_ns = started_ns;
+  entry.finished_ns = finished_ns;
+  --pending_;
+}
+
+PipelineKey PipelineLibrary::FallbackKey(DrawPath draw_path) const {
+  PipelineKey key = fallback_key_;
+  key.draw_path = draw_path;
+  return key;
+}
+
+VkPipeline PipelineLibrary::CreatePipeline(const PipelineKey& key) const {
+  TRACE_SCOPE("vulkan", "vkCreateGraphicsPipelines");
+  VkPipelineInputAssemblyStateCreateInfo ia{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+
+  // The viewport and scissor will be set dynamically via
+  // vkCmdSetViewport/Scissor. This way the pipeline does not need to be touched
+  // when resizing the window.
+  VkPipelineViewportStateCreateInfo vp{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1};
+
+  VkPipelineRasterizationStateCreateInfo rs{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,  // we want the back face as well
+      .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+      .lineWidth = 1.0f};
+
+  VkPipelineMultisampleStateCreateInfo ms{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      // Enable multisampling.
+      .rasterizationSamples = key.sample_count};
+
+  // Blended variants are see-through, so they must not hide what is behind.
+  const bool blend = key.blend != BlendMode::kOpaque;
+  VkPipelineDepthStencilStateCreateInfo ds{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = blend ? VK_FALSE : VK_TRUE,
+      .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL};
+
+  VkPipelineColorBlendAttachmentState att{.colorWriteMask = 0xF};
+  if (blend) {
+    att.blendEnable = VK_TRUE;
+    att.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    att.dstColorBlendFactor = key.blend == BlendMode::kAdditive
+                                  ? VK_BLEND_FACTOR_ONE
+                                  : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    att.colorBlendOp = VK_BLEND_OP_ADD;
+    att.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    att.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    att.alphaBlendOp = VK_BLEND_OP_ADD;
+  }
+  VkPipelineColorBlendStateCreateInfo cb{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &att};
+
+  VkDynamicState dyn_enable[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                 VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dyn{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = sizeof(dyn_enable) / sizeof(VkDynamicState),
+      .pDynamicStates = dyn_enable};
+
+  // Shader features are baked in through specialization constants, so the
+  // driver can drop the unused branches of color.frag per variant.
+  const SpecializationData spec_data{.features = key.features,
+                                     .alpha = blend ? 0.6f : 1.0f};
+  const VkSpecializationMapEntry spec_entries[] = {
+      {.constantID = 0,
+       .offset = offsetof(SpecializationData, features),
+       .size = sizeof(quint32)},
+      {.constantID = 1,
+       .offset = offsetof(SpecializationData, alpha),
+       .size = sizeof(float)}};
+  const VkSpecializationInfo spec_info{
+      .mapEntryCount = 2,
+      .pMapEntries = spec_entries,
+      .dataSize = sizeof(spec_data),
+      .pData = &spec_data};
+
+  VkPipelineShaderStageCreateInfo shader_stages[2] = {
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+       .pNext = nullptr,
+       .flags = 0,
+       .stage = VK_SHADER_STAGE_VERTEX_BIT,
+       .module = context_.vert_shaders[int(key.draw_path)],
+       .pName = "main",
+       .pSpecializationInfo = nullptr},
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+       .pNext = nullptr,
+       .flags = 0,
+       .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+       .module = context_.frag_shader,
+       .pName = "main",
+       .pSpecializationInfo = &spec_info}};
+
+  // Graphics pipeline
+  VkVertexInputBindingDescription vertex_binding_desc = {
+      .binding = 0,
+      .stride = 5 * sizeof(float),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+  VkVertexInputAttributeDescription vertex_attr_desc[] = {
+      // position
+      {.location = 0,
+       .binding = 0,
+       .format = VK_FORMAT_R32G32_SFLOAT,
+       .offset = 0},
+      // color
+      {.location = 1,
+       .binding = 0,
+       .format = VK_FORMAT_R32G32B32_SFLOAT,
+       .offset = 2 * sizeof(float)}};
+  VkPipelineVertexInputStateCreateInfo vertex_input_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .vertexBindingDescriptionCount = 1,
+      .pVertexBindingDescriptions = &vertex_binding_desc,
+      .vertexAttributeDescriptionCount = 2,
+      .pVertexAttributeDescriptions = vertex_attr_desc};
+  VkGraphicsPipelineCreateInfo pipeline_info{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .stageCount = 2,
+      .pStages = shader_stages,
+      .pVertexInputState = &vertex_input_info,
+      .pInputAssemblyState = &ia,
+      .pViewportState = &vp,
+      .pRasterizationState = &rs,
+      .pMultisampleState = &ms,
+      .pDepthStencilState = &ds,
+      .pColorBlendState = &cb,
+      .pDynamicState = &dyn,
+      .layout = context_.pipeline_layouts[int(key.draw_path)],
+      .renderPass = context_.render_pass};
+
+  // The pipeline cache is internally synchronized, so all workers share it.
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  VkResult err = context_.device_functions->vkCreateGraphicsPipelines(
+      context_.device, context_.pipeline_cache, 1, &pipeline_info, nullptr,
+      &pipeline);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to create graphics pipeline: %d", err);
+    return VK_NULL_HANDLE;
+  }
+  return pipeline;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
+#include <QtGui/QVulkanFunctions>
+
+enum class BlendMode : quint8 { kOpaque, kAlpha, kAdditive };
+
+// How per-draw data (the MVP matrix) reaches the vertex shader. Each path has
+// its own vertex shader and pipeline layout.
+enum class DrawPath : quint8 {
+  kPushConstants,   // vkCmdPushConstants per draw, color_push.vert
+  kDynamicUniform,  // one dynamic UBO, new dynamic offset per draw, color.vert
+  kStorageBuffer,   // one SSBO indexed by firstInstance, color_ssbo.vert
+};
+constexpr int kDrawPathCount{3};
+
+const char* DrawPathName(DrawPath path);
+
+// Feature bits, passed to color.frag as specialization constant 0.
+enum ShaderFeature : quint32 {
+  kShaderFeatureGrayscale = 1U << 0,
+  kShaderFeatureInvert = 1U << 1,
+  kShaderFeatureScanlines = 1U << 2,
+  kShaderFeatureAll = (1U << 3) - 1,
+};
+
+struct PipelineKey {
+  DrawPath draw_path{DrawPath::kDynamicUniform};
+  VkSampleCountFlagBits sample_count{VK_SAMPLE_COUNT_1_BIT};
+  BlendMode blend{BlendMode::kOpaque};
+  quint32 features{};
+
+  friend bool operator==(const PipelineKey&, const PipelineKey&) = default;
+};
+
+inline size_t qHash(const PipelineKey& key, size_t seed = 0) noexcept {
+  return ::qHash((quint32(key.draw_path) << 28) |
+                     (quint32(key.sample_count) << 20) |
+                     (quint32(key.blend) << 16) | key.features,
+                 seed);
+}
+
+// Graphics pipeline variants of the triangle, compiled on worker threads
+// against one shared VkPipelineCache. Get() does not wait for them: until a
+// variant is ready the fallback pipeline of its draw path is returned instead.
+// Fallbacks are the only pipelines compiled synchronously, by Init() for the
+// first draw path and by Get() the first time another path is drawn.
+class PipelineLibrary {
+ public:
+  struct Context {
+    VkDevice device{VK_NULL_HANDLE};
+    QVulkanDeviceFunctions* device_functions{};
+    VkPipelineCache pipeline_cache{VK_NULL_HANDLE};
+    VkPipelineLayout pipeline_layouts[kDrawPathCount]{};
+    VkRenderPass render_pass{VK_NULL_HANDLE};
+    VkShaderModule vert_shaders[kDrawPathCount]{};
+    VkShaderModule frag_shader{VK_NULL_HANDLE};
+  };
+
+  PipelineLibrary();
+
+  void Init(const Context& context, const PipelineKey& fallback) noexcept;
+  // Drops queued compiles, waits for the running ones, then destroys every
+  // pipeline.
+  void Release() noexcept;
+
+  // Returns the pipeline for `key` if it is compiled, otherwise queues it and
+  // returns the fallback of `key.draw_path`. `*ready` tells which one the
+  // caller got.
+  VkPipeline Get(const PipelineKey& key, bool* ready = nullptr) noexcept;
+  // Queues all `keys` that are not known yet.
+  void Prewarm(const QList<PipelineKey>& keys) noexcept;
+  bool Idle() noexcept;
+
+  // Logs per-variant queue and compile times.
+  void Report() noexcept;
+
+ private:
+  struct Entry {
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    bool ready{false};
+    bool fallback{false};  // pipeline is owned by fallbacks_
+    qint64 queued_ns{};
+    qint64 started_ns{};
+    qint64 finished_ns{};
+  };
+
+  // mutex_ must be held for these two.
+  void Queue(const PipelineKey& key);
+  VkPipeline Fallback(DrawPath draw_path);
+
+  void Compile(const PipelineKey& key);
+  VkPipeline CreatePipeline(const PipelineKey& key) const;
+  PipelineKey FallbackKey(DrawPath draw_path) const;
+
+  Context context_;
+  PipelineKey fallback_key_;
+  VkPipeline fallbacks_[kDrawPathCount]{};
+  qint64 fallback_compile_ns_[kDrawPathCount]{};
+
+  QThreadPool thread_pool_;
+  QElapsedTimer clock_;
+  QMutex mutex_;
+  QHash<PipelineKey, Entry> entries_;
+  int pending_{};
+};
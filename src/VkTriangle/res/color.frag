@@ -4,7 +4,21 @@ layout(location = 0) in vec3 v_color;
 
 layout(location = 0) out vec4 fragColor;
 
+// Set per pipeline variant, see PipelineLibrary.
+layout(constant_id = 0) const uint features = 0;  // ShaderFeature bits
+layout(constant_id = 1) const float alpha = 1.0;
+
 void main()
 {
-    fragColor = vec4(v_color, 1.0);
+    vec3 color = v_color;
+    if ((features & 1u) != 0u) {  // kShaderFeatureGrayscale
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+    if ((features & 2u) != 0u) {  // kShaderFeatureInvert
+        color = vec3(1.0) - color;
+    }
+    if ((features & 4u) != 0u) {  // kShaderFeatureScanlines
+        color *= mod(floor(gl_FragCoord.y), 2.0) < 1.0 ? 1.0 : 0.5;
+    }
+    fragColor = vec4(color, alpha);
 }
@@ -0,0 +1,19 @@
+#version 440
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 v_color;
+
+// DrawPath::kPushConstants: the matrix is pushed before every draw.
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+} pc;
+
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+    v_color = color;
+    gl_Position = pc.mvp * position;
+}
@@ -0,0 +1,20 @@
+#version 440
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 v_color;
+
+// DrawPath::kStorageBuffer: all matrices of the frame in one buffer, the draw
+// picks its own through firstInstance.
+layout(std430, binding = 0) readonly buffer Objects {
+    mat4 mvp[];
+} objects;
+
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+    v_color = color;
+    gl_Position = objects.mvp[gl_InstanceIndex] * position;
+}
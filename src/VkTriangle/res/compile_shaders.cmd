@@ -9,5 +9,8 @@ if not exist %GLSLC_BIN% (
 )
 
 %GLSLC_BIN% color.vert -o color_vert.spv
+%GLSLC_BIN% color_push.vert -o color_push_vert.spv
+%GLSLC_BIN% color_ssbo.vert -o color_ssbo_vert.spv
 %GLSLC_BIN% color.frag -o color_frag.spv
+%GLSLC_BIN% simulate.comp -o simulate_comp.spv
 pause
@@ -1,3 +1,6 @@
 # sudo apt install glslc
 glslc color.vert -o color_vert.spv
+glslc color_push.vert -o color_push_vert.spv
+glslc color_ssbo.vert -o color_ssbo_vert.spv
 glslc color.frag -o color_frag.spv
+glslc simulate.comp -o simulate_comp.spv
@@ -0,0 +1,811 @@
+#include "transform_simulation.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <QtCore/QFile>
+
+namespace {
+constexpr VkDeviceSize kMatrixSize{16 * sizeof(float)};
+constexpr VkDeviceSize kStateSize{2 * sizeof(float)};  // offset, velocity
+constexpr uint32_t kLocalSize{64};                      // simulate.comp
+
+// Matches the push constant block of simulate.comp.
+struct PushConstants {
+  float projection[16];
+  float rotation;
+  float time;
+  uint32_t count;
+  uint32_t columns;
+  uint32_t substeps;
+};
+
+inline VkDeviceSize Aligned(VkDeviceSize v, VkDeviceSize byte_align) {
+  return (v + byte_align - 1) & ~(byte_align - 1);
+}
+
+inline quint64 TimestampMask(uint32_t valid_bits) {
+  return valid_bits >= 64 ? ~0ULL : (1ULL << valid_bits) - 1;
+}
+}  // namespace
+
+bool SupportsTimestampCalibration(QVulkanInstance* instance,
+                                  VkPhysicalDevice physical_device) {
+  QVulkanFunctions* f = instance->functions();
+  uint32_t count{};
+  f->vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count,
+                                          nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  f->vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count,
+                                          extensions.data());
+  if (std::none_of(extensions.begin(), extensions.end(),
+                   [](const VkExtensionProperties& extension) {
+                     return 0 == std::strcmp(extension.extensionName,
+                                             kTimestampCalibrationExtension);
+                   })) {
+    return false;
+  }
+
+  const auto get_time_domains =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+          instance->getInstanceProcAddr(
+              "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+  if (!get_time_domains) {
+    return false;
+  }
+  count = 0;
+  get_time_domains(physical_device, &count, nullptr);
+  std::vector<VkTimeDomainEXT> domains(count);
+  get_time_domains(physical_device, &count, domains.data());
+  const auto has = [&domains](VkTimeDomainEXT domain) {
+    return std::find(domains.begin(), domains.end(), domain) != domains.end();
+  };
+  return has(VK_TIME_DOMAIN_DEVICE_EXT) &&
+         has(VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT);
+}
+
+const char* SimulationModeName(SimulationMode mode) {
+  switch (mode) {
+    case SimulationMode::kOff:
+      return "off";
+    case SimulationMode::kSerial:
+      return "serial";
+    case SimulationMode::kAsync:
+      return "async";
+  }
+  return "?";
+}
+
+void TransformSimulation::Init(const SimulationContext& context) noexcept {
+  context_ = context;
+  context_.object_count = std::max(context_.object_count, 1);
+  device_functions_ = context_.device_functions;
+  slots_ = std::clamp(context_.concurrent_frame_count + 1, 2, kMaxSlots);
+
+  CreateBuffer();
+  CreateDescriptors();
+  CreatePipeline();
+  CreateCommands();
+
+  cleared_ = false;
+  frame_ = 0;
+  simulated_frame_ = -1;
+  std::fill(std::begin(simulated_pending_), std::end(simulated_pending_),
+            false);
+  std::fill(std::begin(rendered_pending_), std::end(rendered_pending_), false);
+  std::fill(std::begin(graphics_frame_), std::end(graphics_frame_), -1);
+  std::fill(std::begin(compute_frame_), std::end(compute_frame_), -1);
+  render_intervals_.clear();
+  sim_intervals_.clear();
+  stats_ = {};
+
+  calibrated_ = false;
+  get_calibrated_timestamps_ = nullptr;
+  if (context_.calibrated_timestamps && context_.instance) {
+    get_calibrated_timestamps_ =
+        reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+            context_.instance->getInstanceProcAddr(
+                "vkGetCalibratedTimestampsEXT"));
+    calibrated_ = get_calibrated_timestamps_ && Calibrate();
+  }
+
+  qInfo("Transform simulation: %d objects, %s (graphics family %u, compute "
+        "family %u), %d buffers, timestamps %s",
+        context_.object_count,
+        async() ? "async compute queue" : "serial on the graphics queue",
+        context_.graphics_family, context_.compute_family, slots_,
+        calibrated_ ? "calibrated to CLOCK_MONOTONIC" : "per queue");
+}
+
+void TransformSimulation::ResetStats() noexcept {
+  stats_ = {};
+  if (calibrated_) {
+    Calibrate();
+  }
+}
+
+void TransformSimulation::Release() noexcept {
+  VkDevice dev = context_.device;
+  if (!dev) {
+    return;
+  }
+
+  for (int slot = 0; slot < slots_; ++slot) {
+    for (VkFence* fence : {&graphics_fence_[slot], &compute_fence_[slot]}) {
+      if (*fence) {
+        device_functions_->vkWaitForFences(dev, 1, fence, VK_TRUE,
+                                           UINT64_MAX);
+        device_functions_->vkDestroyFence(dev, *fence, nullptr);
+        *fence = VK_NULL_HANDLE;
+      }
+    }
+    for (VkSemaphore* semaphore : {&simulated_[slot], &rendered_[slot]}) {
+      if (*semaphore) {
+        device_functions_->vkDestroySemaphore(dev, *semaphore, nullptr);
+        *semaphore = VK_NULL_HANDLE;
+      }
+    }
+    wait_cb_[slot] = signal_cb_[slot] = compute_cb_[slot] = VK_NULL_HANDLE;
+    compute_set_[slot] = object_set_[slot] = VK_NULL_HANDLE;
+  }
+
+  for (VkQueryPool* pool : {&graphics_queries_, &compute_queries_}) {
+    if (*pool) {
+      device_functions_->vkDestroyQueryPool(dev, *pool, nullptr);
+      *pool = VK_NULL_HANDLE;
+    }
+  }
+  // Frees the command buffers as well.
+  for (VkCommandPool* pool : {&graphics_pool_, &compute_pool_}) {
+    if (*pool) {
+      device_functions_->vkDestroyCommandPool(dev, *pool, nullptr);
+      *pool = VK_NULL_HANDLE;
+    }
+  }
+
+  if (pipeline_) {
+    device_functions_->vkDestroyPipeline(dev, pipeline_, nullptr);
+    pipeline_ = VK_NULL_HANDLE;
+  }
+  if (pipeline_layout_) {
+    device_functions_->vkDestroyPipelineLayout(dev, pipeline_layout_, nullptr);
+    pipeline_layout_ = VK_NULL_HANDLE;
+  }
+  if (desc_pool_) {
+    device_functions_->vkDestroyDescriptorPool(dev, desc_pool_, nullptr);
+    desc_pool_ = VK_NULL_HANDLE;
+  }
+  if (compute_set_layout_) {
+    device_functions_->vkDestroyDescriptorSetLayout(dev, compute_set_layout_,
+                                                    nullptr);
+    compute_set_layout_ = VK_NULL_HANDLE;
+  }
+  if (buffer_) {
+    device_functions_->vkDestroyBuffer(dev, buffer_, nullptr);
+    buffer_ = VK_NULL_HANDLE;
+  }
+  if (memory_) {
+    device_functions_->vkFreeMemory(dev, memory_, nullptr);
+    memory_ = VK_NULL_HANDLE;
+  }
+  context_.device = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet TransformSimulation::BeginFrame(
+    const SimulationParams& params) noexcept {
+  if (simulated_frame_ < frame_) {
+    Simulate(params);  // nothing was simulated ahead
+  }
+  const int slot = int(frame_ % slots_);
+  VkDevice dev = context_.device;
+  if (calibrated_ && frame_ - calibrated_frame_ >= kCalibrationFrames) {
+    Calibrate();  // the two clocks drift apart
+  }
+
+  // The slot's batches from slots_ frames ago must be done before their
+  // command buffers are recorded again.
+  device_functions_->vkWaitForFences(dev, 1, &graphics_fence_[slot], VK_TRUE,
+                                     UINT64_MAX);
+  CollectGraphics(slot);
+
+  VkCommandBuffer cb = wait_cb_[slot];
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  device_functions_->vkBeginCommandBuffer(cb, &begin_info);
+  if (graphics_queries_) {
+    device_functions_->vkCmdResetQueryPool(cb, graphics_queries_, slot * 2, 2);
+  }
+  // A semaphore wait only holds back its own batch. The barrier chains onto
+  // it and carries it over to everything submitted later, i.e. the frame's
+  // vertex shaders.
+  VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+  device_functions_->vkCmdPipelineBarrier(
+      cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+      nullptr);
+  if (graphics_queries_) {
+    // After the barrier, so the interval starts once drawing can.
+    device_functions_->vkCmdWriteTimestamp(
+        cb, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, graphics_queries_, slot * 2);
+  }
+  device_functions_->vkEndCommandBuffer(cb);
+
+  const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkSubmitInfo submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                           .waitSemaphoreCount =
+                               simulated_pending_[slot] ? 1U : 0U,
+                           .pWaitSemaphores = &simulated_[slot],
+                           .pWaitDstStageMask = &wait_stage,
+                           .commandBufferCount = 1,
+                           .pCommandBuffers = &cb};
+  VkResult err = device_functions_->vkQueueSubmit(
+      context_.graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to submit simulation wait: %d", err);
+  }
+  simulated_pending_[slot] = false;
+  return object_set_[slot];
+}
+
+void TransformSimulation::EndFrame(const SimulationParams& next) noexcept {
+  const int slot = int(frame_ % slots_);
+  VkDevice dev = context_.device;
+
+  VkCommandBuffer cb = signal_cb_[slot];
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  device_functions_->vkBeginCommandBuffer(cb, &begin_info);
+  if (graphics_queries_) {
+    // Written once everything submitted before it, i.e. the frame, is done.
+    device_functions_->vkCmdWriteTimestamp(
+        cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graphics_queries_,
+        slot * 2 + 1);
+  }
+  device_functions_->vkEndCommandBuffer(cb);
+
+  device_functions_->vkResetFences(dev, 1, &graphics_fence_[slot]);
+  VkSubmitInfo submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                           .commandBufferCount = 1,
+                           .pCommandBuffers = &cb,
+                           .signalSemaphoreCount = 1,
+                           .pSignalSemaphores = &rendered_[slot]};
+  VkResult err = device_functions_->vkQueueSubmit(
+      context_.graphics_queue, 1, &submit_info, graphics_fence_[slot]);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to submit simulation signal: %d", err);
+  }
+  rendered_pending_[slot] = true;
+  graphics_frame_[slot] = frame_;
+
+  ++frame_;
+  Simulate(next);
+}
+
+void TransformSimulation::Simulate(const SimulationParams& params) {
+  const qint64 frame = simulated_frame_ + 1;
+  const int slot = int(frame % slots_);
+  VkDevice dev = context_.device;
+
+  device_functions_->vkWaitForFences(dev, 1, &compute_fence_[slot], VK_TRUE,
+                                     UINT64_MAX);
+  CollectCompute(slot);
+
+  VkCommandBuffer cb = compute_cb_[slot];
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  device_functions_->vkBeginCommandBuffer(cb, &begin_info);
+  if (compute_queries_) {
+    device_functions_->vkCmdResetQueryPool(cb, compute_queries_, slot * 2, 2);
+    device_functions_->vkCmdWriteTimestamp(
+        cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, compute_queries_, slot * 2);
+  }
+
+  if (!cleared_) {
+    // The springs start at rest.
+    cleared_ = true;
+    device_functions_->vkCmdFillBuffer(cb, buffer_, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                                             VK_ACCESS_SHADER_WRITE_BIT};
+    device_functions_->vkCmdPipelineBarrier(
+        cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+        nullptr);
+  } else {
+    // Reads the states the previous simulation wrote, overwrites the ones it
+    // read.
+    VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                                             VK_ACCESS_SHADER_WRITE_BIT};
+    device_functions_->vkCmdPipelineBarrier(
+        cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+        nullptr);
+  }
+
+  PushConstants push{.rotation = params.rotation,
+                     .time = float(frame) / 60.0f,
+                     .count = uint32_t(context_.object_count),
+                     .columns = uint32_t(std::max(params.grid_columns, 1)),
+                     .substeps = kSubsteps};
+  std::copy_n(params.projection.constData(), 16, push.projection);
+  device_functions_->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                       pipeline_);
+  device_functions_->vkCmdBindDescriptorSets(
+      cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1,
+      &compute_set_[slot], 0, nullptr);
+  device_functions_->vkCmdPushConstants(cb, pipeline_layout_,
+                                        VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                        sizeof(push), &push);
+  device_functions_->vkCmdDispatch(
+      cb, (uint32_t(context_.object_count) + kLocalSize - 1) / kLocalSize, 1,
+      1);
+
+  if (compute_queries_) {
+    device_functions_->vkCmdWriteTimestamp(
+        cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, compute_queries_,
+        slot * 2 + 1);
+  }
+  device_functions_->vkEndCommandBuffer(cb);
+
+  // The slot's matrices were last drawn slots_ frames ago; wait for that draw
+  // before overwriting them.
+  const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  const bool wait = rendered_pending_[slot];
+  device_functions_->vkResetFences(dev, 1, &compute_fence_[slot]);
+  VkSubmitInfo submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                           .waitSemaphoreCount = wait ? 1U : 0U,
+                           .pWaitSemaphores = &rendered_[slot],
+                           .pWaitDstStageMask = &wait_stage,
+                           .commandBufferCount = 1,
+                           .pCommandBuffers = &cb,
+                           .signalSemaphoreCount = 1,
+                           .pSignalSemaphores = &simulated_[slot]};
+  VkResult err = device_functions_->vkQueueSubmit(
+      context_.compute_queue, 1, &submit_info, compute_fence_[slot]);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to submit simulation: %d", err);
+  }
+  rendered_pending_[slot] = false;
+  simulated_pending_[slot] = true;
+  compute_frame_[slot] = frame;
+  simulated_frame_ = frame;
+}
+
+void TransformSimulation::CollectGraphics(int slot) {
+  const qint64 frame = graphics_frame_[slot];
+  graphics_frame_[slot] = -1;
+  // Overlap needs both ends; without either pool nothing is paired up.
+  if (frame < 0 || !graphics_queries_ || !compute_queries_) {
+    return;
+  }
+  Interval interval;
+  if (Read(graphics_queries_, slot, context_.graphics_timestamp_bits,
+           &interval)) {
+    render_intervals_.insert(frame, interval);
+    Pair(frame);
+  }
+}
+
+void TransformSimulation::CollectCompute(int slot) {
+  const qint64 frame = compute_frame_[slot];
+  compute_frame_[slot] = -1;
+  if (frame < 0 || !graphics_queries_ || !compute_queries_) {
+    return;
+  }
+  Interval interval;
+  if (Read(compute_queries_, slot, context_.compute_timestamp_bits,
+           &interval)) {
+    sim_intervals_.insert(frame, interval);
+    Pair(frame - 1);
+  }
+}
+
+bool TransformSimulation::Read(VkQueryPool pool,
+                               int slot,
+                               uint32_t valid_bits,
+                               Interval* interval) {
+  quint64 timestamps[2]{};
+  VkResult err = device_functions_->vkGetQueryPoolResults(
+      context_.device, pool, slot * 2, 2, sizeof(timestamps), timestamps,
+      sizeof(quint64), VK_QUERY_RESULT_64_BIT);
+  if (err != VK_SUCCESS) {
+    return false;
+  }
+  const quint64 mask = TimestampMask(valid_bits);
+  const double period = context_.limits->timestampPeriod;
+  const double offset = calibrated_ ? device_to_host_ns_ : 0.0;
+  interval->begin_ns = qint64((timestamps[0] & mask) * period + offset);
+  interval->end_ns = qint64((timestamps[1] & mask) * period + offset);
+  return interval->end_ns >= interval->begin_ns;
+}
+
+void TransformSimulation::Pair(qint64 frame) {
+  // Frame N is drawn while N+1 is simulated.
+  const auto render = render_intervals_.constFind(frame);
+  const auto sim = sim_intervals_.constFind(frame + 1);
+  if (render == render_intervals_.cend() || sim == sim_intervals_.cend()) {
+    return;
+  }
+  ++stats_.frames;
+  stats_.render_ns += double(render->end_ns - render->begin_ns);
+  stats_.sim_ns += double(sim->end_ns - sim->begin_ns);
+  // Only the lengths mean something unless both intervals are on one
+  // queue or were mapped to CLOCK_MONOTONIC.
+  if (comparable()) {
+    const qint64 begin = std::max(render->begin_ns, sim->begin_ns);
+    const qint64 end = std::min(render->end_ns, sim->end_ns);
+    stats_.overlap_ns += end > begin ? double(end - begin) : 0.0;
+  }
+  render_intervals_.erase(render);
+  sim_intervals_.erase(sim);
+}
+
+bool TransformSimulation::Calibrate() {
+  const VkCalibratedTimestampInfoEXT infos[2]{
+      {.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+       .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT},
+      {.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+       .timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT}};
+  uint64_t timestamps[2]{};
+  uint64_t max_deviation{};
+  const VkResult err = get_calibrated_timestamps_(
+      context_.device, 2, infos, timestamps, &max_deviation);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to calibrate timestamps: %d", err);
+    return false;
+  }
+  const quint64 device_ticks =
+      timestamps[0] & TimestampMask(context_.graphics_timestamp_bits);
+  device_to_host_ns_ = double(timestamps[1]) -
+                       double(device_ticks) * context_.limits->timestampPeriod;
+  calibrated_frame_ = frame_;
+  return true;
+}
+
+QJsonObject TransformSimulation::Report() const {
+  const char* mode = async() ? "async" : "serial";
+  if (!stats_.frames) {
+    qInfo("Simulation (%s): no timings, a queue lacks timestamp support",
+          mode);
+    return {{"simulation", mode},
+            {"sim_us", -1},
+            {"render_us", -1},
+            {"overlap_us", -1},
+            {"overlap_ratio", -1}};
+  }
+  const double sim_us = stats_.sim_ns / 1e3 / stats_.frames;
+  const double render_us = stats_.render_ns / 1e3 / stats_.frames;
+  if (!comparable()) {
+    qInfo("Simulation (%s): sim %.2f us, render %.2f us; overlap unknown "
+          "without %s, compare the frame rates of serial and async runs",
+          mode, sim_us, render_us, kTimestampCalibrationExtension);
+    return {{"simulation", mode},
+            {"sim_us", sim_us},
+            {"render_us", render_us},
+            {"overlap_us", -1},
+            {"overlap_ratio", -1}};
+  }
+  const double overlap_us = stats_.overlap_ns / 1e3 / stats_.frames;
+  const double ratio = stats_.sim_ns > 0 ? stats_.overlap_ns / stats_.sim_ns
+                                         : 0.0;
+  qInfo("Simulation (%s): sim %.2f us, render %.2f us, overlapped %.2f us "
+        "(%.0f%% of the simulation hidden)",
+        mode, sim_us, render_us, overlap_us, ratio * 100);
+  return {{"simulation", mode},
+          {"sim_us", sim_us},
+          {"render_us", render_us},
+          {"overlap_us", overlap_us},
+          {"overlap_ratio", ratio}};
+}
+
+void TransformSimulation::CreateBuffer() {
+  VkDevice dev = context_.device;
+  const VkDeviceSize alignment =
+      std::max<VkDeviceSize>(context_.limits->minStorageBufferOffsetAlignment,
+                             16);
+  const VkDeviceSize count = VkDeviceSize(context_.object_count);
+
+  // matrices 0, 1, ..., then states 0, 1, ...
+  VkDeviceSize size = 0;
+  for (int slot = 0; slot < slots_; ++slot) {
+    matrix_offset_[slot] = size;
+    size = Aligned(size + count * kMatrixSize, alignment);
+  }
+  for (int slot = 0; slot < slots_; ++slot) {
+    state_offset_[slot] = size;
+    size = Aligned(size + count * kStateSize, alignment);
+  }
+
+  // Shared by both queue families, so no ownership transfers are needed.
+  const uint32_t families[] = {context_.graphics_family,
+                               context_.compute_family};
+  const bool concurrent = context_.graphics_family != context_.compute_family;
+  VkBufferCreateInfo buffer_info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = size,
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode =
+          concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = concurrent ? 2U : 0U,
+      .pQueueFamilyIndices = concurrent ? families : nullptr};
+  VkResult err =
+      device_functions_->vkCreateBuffer(dev, &buffer_info, nullptr, &buffer_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create simulation buffer: %d", err);
+  }
+
+  VkMemoryRequirements mem_req;
+  device_functions_->vkGetBufferMemoryRequirements(dev, buffer_, &mem_req);
+  const int memory_index =
+      PickMemoryType(mem_req.memoryTypeBits, mem_req.size);
+  if (memory_index < 0) {
+    qFatal("No memory type can hold the simulation buffer (type bits 0x%x)",
+           mem_req.memoryTypeBits);
+  }
+  VkMemoryAllocateInfo mem_alloc_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                                      nullptr, mem_req.size,
+                                      uint32_t(memory_index)};
+  err = device_functions_->vkAllocateMemory(dev, &mem_alloc_info, nullptr,
+                                            &memory_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to allocate simulation memory: %d", err);
+  }
+  err = device_functions_->vkBindBufferMemory(dev, buffer_, memory_, 0);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to bind simulation memory: %d", err);
+  }
+}
+
+int TransformSimulation::PickMemoryType(uint32_t type_bits,
+                                        VkDeviceSize size) const {
+  const VkPhysicalDeviceMemoryProperties& memory = *context_.memory_properties;
+  const auto fits = [&](uint32_t type) {
+    return type < memory.memoryTypeCount && ((type_bits >> type) & 1) &&
+           size <= memory.memoryHeaps[memory.memoryTypes[type].heapIndex].size;
+  };
+  // The tuned type may come from a profile saved for another driver version.
+  const int tuned = context_.device_local_memory_index;
+  if (tuned >= 0) {
+    if (fits(uint32_t(tuned))) {
+      return tuned;
+    }
+    qWarning("Memory type %d cannot hold the simulation buffer", tuned);
+  }
+  int any = -1;
+  for (uint32_t type = 0; type < memory.memoryTypeCount; ++type) {
+    if (!fits(type)) {
+      continue;
+    }
+    if (memory.memoryTypes[type].propertyFlags &
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+      return int(type);
+    }
+    if (any < 0) {
+      any = int(type);
+    }
+  }
+  return any;
+}
+
+void TransformSimulation::CreateDescriptors() {
+  VkDevice dev = context_.device;
+
+  // 0: matrices out, 1: previous states in, 2: states out.
+  VkDescriptorSetLayoutBinding bindings[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    bindings[i] = {.binding = i,
+                   .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   .descriptorCount = 1,
+                   .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT};
+  }
+  VkDescriptorSetLayoutCreateInfo layout_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 3,
+      .pBindings = bindings};
+  VkResult err = device_functions_->vkCreateDescriptorSetLayout(
+      dev, &layout_info, nullptr, &compute_set_layout_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create descriptor set layout: %d", err);
+  }
+
+  VkDescriptorPoolSize pool_size{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = uint32_t(slots_ * 4)};
+  VkDescriptorPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = uint32_t(slots_ * 2),
+      .poolSizeCount = 1,
+      .pPoolSizes = &pool_size};
+  err = device_functions_->vkCreateDescriptorPool(dev, &pool_info, nullptr,
+                                                  &desc_pool_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create descriptor pool: %d", err);
+  }
+
+  const VkDeviceSize count = VkDeviceSize(context_.object_count);
+  for (int slot = 0; slot < slots_; ++slot) {
+    VkDescriptorSetAllocateInfo alloc_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = desc_pool_,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &compute_set_layout_};
+    err = device_functions_->vkAllocateDescriptorSets(dev, &alloc_info,
+                                                      &compute_set_[slot]);
+    if (err != VK_SUCCESS) {
+      qFatal("Failed to allocate descriptor set: %d", err);
+    }
+    alloc_info.pSetLayouts = &context_.object_set_layout;
+    err = device_functions_->vkAllocateDescriptorSets(dev, &alloc_info,
+                                                      &object_set_[slot]);
+    if (err != VK_SUCCESS) {
+      qFatal("Failed to allocate descriptor set: %d", err);
+    }
+
+    const VkDescriptorBufferInfo matrices{.buffer = buffer_,
+                                          .offset = matrix_offset_[slot],
+                                          .range = count * kMatrixSize};
+    const VkDescriptorBufferInfo states_in{
+        .buffer = buffer_,
+        .offset = state_offset_[(slot + slots_ - 1) % slots_],
+        .range = count * kStateSize};
+    const VkDescriptorBufferInfo states_out{.buffer = buffer_,
+                                            .offset = state_offset_[slot],
+                                            .range = count * kStateSize};
+    const VkDescriptorBufferInfo* infos[] = {&matrices, &states_in,
+                                             &states_out};
+    VkWriteDescriptorSet writes[4];
+    for (uint32_t i = 0; i < 3; ++i) {
+      writes[i] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                   .dstSet = compute_set_[slot],
+                   .dstBinding = i,
+                   .descriptorCount = 1,
+                   .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   .pBufferInfo = infos[i]};
+    }
+    writes[3] = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                 .dstSet = object_set_[slot],
+                 .dstBinding = 0,
+                 .descriptorCount = 1,
+                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                 .pBufferInfo = &matrices};
+    device_functions_->vkUpdateDescriptorSets(dev, 4, writes, 0, nullptr);
+  }
+}
+
+void TransformSimulation::CreatePipeline() {
+  VkDevice dev = context_.device;
+
+  VkPushConstantRange push_range{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                                 .offset = 0,
+                                 .size = sizeof(PushConstants)};
+  VkPipelineLayoutCreateInfo layout_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &compute_set_layout_,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_range};
+  VkResult err = device_functions_->vkCreatePipelineLayout(
+      dev, &layout_info, nullptr, &pipeline_layout_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create pipeline layout: %d", err);
+  }
+
+  QFile file(QStringLiteral(":/simulate_comp.spv"));
+  if (!file.open(QIODevice::ReadOnly)) {
+    qFatal("Failed to read shader %s", qPrintable(file.fileName()));
+  }
+  const QByteArray blob = file.readAll();
+  VkShaderModuleCreateInfo shader_info{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = static_cast<size_t>(blob.size()),
+      .pCode = reinterpret_cast<const uint32_t*>(blob.constData())};
+  VkShaderModule shader_module;
+  err = device_functions_->vkCreateShaderModule(dev, &shader_info, nullptr,
+                                                &shader_module);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create shader module: %d", err);
+  }
+
+  VkComputePipelineCreateInfo pipeline_info{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main"},
+      .layout = pipeline_layout_};
+  err = device_functions_->vkCreateComputePipelines(
+      dev, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_);
+  device_functions_->vkDestroyShaderModule(dev, shader_module, nullptr);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create compute pipeline: %d", err);
+  }
+}
+
+void TransformSimulation::CreateCommands() {
+  VkDevice dev = context_.device;
+
+  VkCommandPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = context_.graphics_family};
+  VkResult err = device_functions_->vkCreateCommandPool(dev, &pool_info,
+                                                        nullptr,
+                                                        &graphics_pool_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create command pool: %d", err);
+  }
+  pool_info.queueFamilyIndex = context_.compute_family;
+  err = device_functions_->vkCreateCommandPool(dev, &pool_info, nullptr,
+                                               &compute_pool_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create command pool: %d", err);
+  }
+
+  VkCommandBufferAllocateInfo cb_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = graphics_pool_,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = uint32_t(slots_)};
+  err = device_functions_->vkAllocateCommandBuffers(dev, &cb_info, wait_cb_);
+  if (err == VK_SUCCESS) {
+    err = device_functions_->vkAllocateCommandBuffers(dev, &cb_info,
+                                                      signal_cb_);
+  }
+  if (err == VK_SUCCESS) {
+    cb_info.commandPool = compute_pool_;
+    err = device_functions_->vkAllocateCommandBuffers(dev, &cb_info,
+                                                      compute_cb_);
+  }
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to allocate command buffers: %d", err);
+  }
+
+  // Signaled, so the first wait on every slot returns immediately.
+  VkFenceCreateInfo fence_info{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                               .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+  VkSemaphoreCreateInfo semaphore_info{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  for (int slot = 0; slot < slots_; ++slot) {
+    for (VkFence* fence : {&graphics_fence_[slot], &compute_fence_[slot]}) {
+      err = device_functions_->vkCreateFence(dev, &fence_info, nullptr, fence);
+      if (err != VK_SUCCESS) {
+        qFatal("Failed to create fence: %d", err);
+      }
+    }
+    for (VkSemaphore* semaphore : {&simulated_[slot], &rendered_[slot]}) {
+      err = device_functions_->vkCreateSemaphore(dev, &semaphore_info, nullptr,
+                                                 semaphore);
+      if (err != VK_SUCCESS) {
+        qFatal("Failed to create semaphore: %d", err);
+      }
+    }
+  }
+
+  // Two timestamps per slot on each queue; queues without timestamp support
+  // get no pool and the overlap goes unmeasured.
+  VkQueryPoolCreateInfo query_pool_info{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = uint32_t(slots_ * 2)};
+  if (context_.graphics_timestamp_bits &&
+      device_functions_->vkCreateQueryPool(dev, &query_pool_info, nullptr,
+                                           &graphics_queries_) != VK_SUCCESS) {
+    graphics_queries_ = VK_NULL_HANDLE;
+  }
+  if (context_.compute_timestamp_bits &&
+      device_functions_->vkCreateQueryPool(dev, &query_pool_info, nullptr,
+                                           &compute_queries_) != VK_SUCCESS) {
+    compute_queries_ = VK_NULL_HANDLE;
+  }
+}
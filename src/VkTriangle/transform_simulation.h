@@ -0,0 +1,184 @@
+#pragma once
+
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+
+#include "triangle_scene.h"
+
+enum class SimulationMode : quint8 { kOff, kSerial, kAsync };
+
+const char* SimulationModeName(SimulationMode mode);
+
+// Timestamps written on different queues are not guaranteed to be
+// comparable. VK_EXT_calibrated_timestamps samples the device clock together
+// with CLOCK_MONOTONIC, which maps both queues into one time domain. True if
+// `physical_device` can do that; the device must then be created with
+// kTimestampCalibrationExtension.
+constexpr const char* kTimestampCalibrationExtension{
+    VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME};
+bool SupportsTimestampCalibration(QVulkanInstance* instance,
+                                  VkPhysicalDevice physical_device);
+
+// Everything the simulation needs from whoever owns the device. With
+// compute_family == graphics_family (and the same queue) it runs serially.
+struct SimulationContext {
+  VkDevice device{VK_NULL_HANDLE};
+  QVulkanDeviceFunctions* device_functions{};
+  const VkPhysicalDeviceLimits* limits{};
+  const VkPhysicalDeviceMemoryProperties* memory_properties{};
+  // Tuned memory type for the buffer, -1 for none. Used if the buffer may be
+  // bound to it, otherwise the first device local type that fits.
+  int device_local_memory_index{-1};
+  VkQueue graphics_queue{VK_NULL_HANDLE};
+  uint32_t graphics_family{};
+  uint32_t graphics_timestamp_bits{};
+  VkQueue compute_queue{VK_NULL_HANDLE};
+  uint32_t compute_family{};
+  uint32_t compute_timestamp_bits{};
+  // Set when the device was created with kTimestampCalibrationExtension;
+  // without it the overlap of async frames cannot be measured.
+  QVulkanInstance* instance{};
+  bool calibrated_timestamps{false};
+  // TriangleScene::storage_set_layout(): the sets handed to Record() use it.
+  VkDescriptorSetLayout object_set_layout{VK_NULL_HANDLE};
+  int object_count{1};
+  int concurrent_frame_count{1};
+};
+
+// Where the object matrices of the next frame come from.
+struct SimulationParams {
+  QMatrix4x4 projection;
+  float rotation{};
+  int grid_columns{1};
+};
+
+// Moves the per-object matrix work of TriangleScene to a compute pass
+// (res/simulate.comp): every object bounces on a damped spring, integrated
+// in substeps, and the pass writes the matrices the SSBO draw path reads.
+//
+// Storage buffers rotate between frames, one more than there are frames in
+// flight: while frame N draws from one, frame N+1 is simulated into the next,
+// on a compute-only queue family when there is one, so the two overlap.
+// Semaphores order it all. QVulkanWindow does not let us add waits to its own
+// submit, so each frame is bracketed by two small batches on the graphics
+// queue: one before it waits for the simulation, one after it signals that
+// the buffer may be overwritten. Those batches also carry the timestamps from
+// which the overlap is measured, once both queues' timestamps are converted
+// to CLOCK_MONOTONIC.
+class TransformSimulation {
+ public:
+  // Integration steps per object and frame, i.e. how heavy the pass is.
+  static constexpr uint32_t kSubsteps{64};
+
+  void Init(const SimulationContext& context) noexcept;
+  void Release() noexcept;
+
+  bool async() const noexcept {
+    return context_.compute_queue != context_.graphics_queue;
+  }
+
+  // Call before the frame's own submit on the graphics queue. Submits the
+  // wait for this frame's simulation (simulating it with `params` first if
+  // nothing was submitted ahead, i.e. on the first frame) and returns the
+  // descriptor set to draw from.
+  VkDescriptorSet BeginFrame(const SimulationParams& params) noexcept;
+  // Call after the frame's own submit. Marks its buffer as read and starts
+  // simulating the next frame with `next`.
+  void EndFrame(const SimulationParams& next) noexcept;
+
+  void ResetStats() noexcept;
+  // Logs the averages since the last ResetStats() and returns them; values
+  // that could not be measured are -1.
+  QJsonObject Report() const;
+
+ private:
+  // Frames in flight plus the one being simulated ahead.
+  static constexpr int kMaxSlots{TriangleScene::kMaxConcurrentFrameCount + 1};
+
+  // Recalibrate the device clock against the host this often.
+  static constexpr qint64 kCalibrationFrames{256};
+
+  // CLOCK_MONOTONIC when calibrated, else the queue's own device time.
+  struct Interval {
+    qint64 begin_ns{};
+    qint64 end_ns{};
+  };
+
+  struct Stats {
+    int frames{};
+    double sim_ns{};
+    double render_ns{};
+    double overlap_ns{};
+  };
+
+  void CreateBuffer();
+  // Memory type for a buffer with `type_bits`, -1 if there is none.
+  int PickMemoryType(uint32_t type_bits, VkDeviceSize size) const;
+  void CreateDescriptors();
+  void CreatePipeline();
+  void CreateCommands();
+  void Simulate(const SimulationParams& params);
+  // Reads the timestamps of `slot` once its batches are done.
+  void CollectGraphics(int slot);
+  void CollectCompute(int slot);
+  bool Read(VkQueryPool pool,
+            int slot,
+            uint32_t valid_bits,
+            Interval* interval);
+  void Pair(qint64 frame);
+  // Samples the device and host clocks; false if that failed.
+  bool Calibrate();
+  // Whether intervals of the two queues can be intersected.
+  bool comparable() const noexcept { return !async() || calibrated_; }
+
+  SimulationContext context_;
+  QVulkanDeviceFunctions* device_functions_{};
+  int slots_{2};
+
+  VkDeviceMemory memory_{VK_NULL_HANDLE};
+  VkBuffer buffer_{VK_NULL_HANDLE};
+  // Per slot: object matrices (read by the draws) and spring states.
+  VkDeviceSize matrix_offset_[kMaxSlots]{};
+  VkDeviceSize state_offset_[kMaxSlots]{};
+  bool cleared_{false};
+
+  VkDescriptorSetLayout compute_set_layout_{VK_NULL_HANDLE};
+  VkDescriptorPool desc_pool_{VK_NULL_HANDLE};
+  VkDescriptorSet compute_set_[kMaxSlots]{};
+  VkDescriptorSet object_set_[kMaxSlots]{};
+  VkPipelineLayout pipeline_layout_{VK_NULL_HANDLE};
+  VkPipeline pipeline_{VK_NULL_HANDLE};
+
+  VkCommandPool graphics_pool_{VK_NULL_HANDLE};
+  VkCommandPool compute_pool_{VK_NULL_HANDLE};
+  VkCommandBuffer wait_cb_[kMaxSlots]{};
+  VkCommandBuffer signal_cb_[kMaxSlots]{};
+  VkCommandBuffer compute_cb_[kMaxSlots]{};
+  VkFence graphics_fence_[kMaxSlots]{};
+  VkFence compute_fence_[kMaxSlots]{};
+  VkSemaphore simulated_[kMaxSlots]{};
+  VkSemaphore rendered_[kMaxSlots]{};
+  // Signaled and not waited for yet; a semaphore must not be signaled twice.
+  bool simulated_pending_[kMaxSlots]{};
+  bool rendered_pending_[kMaxSlots]{};
+  // Frame that last used the slot's graphics / compute batches, -1: none.
+  qint64 graphics_frame_[kMaxSlots]{};
+  qint64 compute_frame_[kMaxSlots]{};
+  VkQueryPool graphics_queries_{VK_NULL_HANDLE};
+  VkQueryPool compute_queries_{VK_NULL_HANDLE};
+  PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps_{};
+  bool calibrated_{false};
+  double device_to_host_ns_{};  // added to device nanoseconds
+  qint64 calibrated_frame_{};
+
+  qint64 frame_{};              // frame being drawn
+  qint64 simulated_frame_{-1};  // last frame submitted to the compute queue
+  // Finished intervals waiting for their partner: frame N renders while
+  // N+1 is simulated.
+  QHash<qint64, Interval> render_intervals_;
+  QHash<qint64, Interval> sim_intervals_;
+  Stats stats_;
+};
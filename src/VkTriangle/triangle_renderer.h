@@ -1,11 +1,18 @@
 ﻿#pragma once
 
+#include <QtCore/QElapsedTimer>
 #include <QtGui/QVulkanWindow>
 
+#include "frame_pacer.h"
+#include "transform_simulation.h"
+#include "triangle_scene.h"
+#include "tuning_profile.h"
+
 class TriangleRenderer : public QVulkanWindowRenderer {
  public:
   TriangleRenderer(QVulkanWindow* w, bool msaa = false) noexcept;
 
+  void preInitResources() noexcept override;
   void initResources() noexcept override;
   void initSwapChainResources() noexcept override;
   void releaseSwapChainResources() noexcept override;
@@ -13,26 +20,48 @@ class TriangleRenderer : public QVulkanWindowRenderer {
 
   void startNextFrame() noexcept override;
 
- private:
-  VkShaderModule CreateShader(const QString& name);
+  // Switches to the next blend mode / shader feature combination. Variants
+  // that are not compiled yet are drawn with the fallback pipeline.
+  void NextBlendMode() noexcept;
+  void NextFeatures() noexcept;
+  // Cycles how the per-object matrices reach the vertex shader.
+  void NextDrawPath() noexcept;
+  // Both take effect when the Vulkan resources are (re)created.
+  void SetObjectCount(int count) noexcept { scene_.SetObjectCount(count); }
+  void SetFramePacing(const FramePacer::Options& options) noexcept {
+    pacer_.SetOptions(options);
+  }
+  // Computes the object matrices on the GPU, on a separate compute queue
+  // for kAsync when the device has one.
+  void SetSimulation(SimulationMode mode) noexcept { simulation_mode_ = mode; }
 
- private:
-  QVulkanWindow* window_;
-  QVulkanDeviceFunctions* device_functions_;
+  // Feeds input timestamps to the latency measurement.
+  void OnInput() noexcept { pacer_.OnInput(); }
 
-  VkDeviceMemory device_memory_{VK_NULL_HANDLE};
-  VkBuffer buffer_{VK_NULL_HANDLE};
-  VkDescriptorBufferInfo
-      buffer_info_[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
+ private:
+  // QVulkanWindow always creates a FIFO swapchain; this only tells whether the
+  // preferred mode would have been available.
+  void CheckPresentMode();
+  // Frame about to be simulated, as far as the scene got.
+  SimulationParams CurrentSimulationParams() const;
 
-  VkDescriptorPool desc_pool_{VK_NULL_HANDLE};
-  VkDescriptorSetLayout desc_set_layout_{VK_NULL_HANDLE};
-  VkDescriptorSet desc_set_[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
+  QVulkanWindow* window_;
+  bool msaa_;
+  // Cached per machine and driver, replaces probing the device at startup.
+  TuningProfile profile_;
+  VkPhysicalDeviceMemoryProperties memory_properties_{};  // for scene_
+  TriangleScene scene_;
+  FramePacer pacer_;
+  SimulationMode simulation_mode_{SimulationMode::kOff};
+  TransformSimulation simulation_;
+  int compute_family_{-1};  // extra queue requested for kAsync, -1: none
+  bool calibrated_timestamps_{false};  // kTimestampCalibrationExtension on
+  QElapsedTimer simulation_report_timer_;
 
-  VkPipelineCache pipeline_cache_{VK_NULL_HANDLE};
-  VkPipelineLayout pipeline_layout_{VK_NULL_HANDLE};
-  VkPipeline pipeline_{VK_NULL_HANDLE};
+  BlendMode blend_{BlendMode::kOpaque};
+  quint32 features_{};
 
-  QMatrix4x4 projection_;
-  float rotation_{0.0f};
+  QElapsedTimer startup_timer_;
+  bool first_frame_reported_{false};
+  bool pipelines_reported_{false};
 };
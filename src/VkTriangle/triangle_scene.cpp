@@ -0,0 +1,502 @@
+#include "triangle_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include <QFile>
+#include <QVulkanFunctions>
+
+namespace {
+// Note that the vertex data and the projection matrix assume OpenGL. With
+// Vulkan Y is negated in clip space and the near/far plane is at 0/1 instead
+// of -1/1. These will be corrected for by an extra transformation when
+// calculating the modelview-projection matrix.
+float vertex_data[] = {
+    // Y up, front = CCW
+    // x    y     R     G     B
+    0.0f,  0.5f,  1.0f, 0.0f, 0.0f,  // 0
+    -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,  // 1
+    0.5f,  -0.5f, 0.0f, 0.0f, 1.0f   // 2
+};
+
+constexpr int kUniformDataSize{16 * sizeof(float)};
+
+inline VkDeviceSize Aligned(VkDeviceSize v, VkDeviceSize byte_align) {
+  return (v + byte_align - 1) & ~(byte_align - 1);
+}
+}  // namespace
+
+void TriangleScene::SetObjectCount(int count) noexcept {
+  object_count_ = std::max(count, 1);
+  grid_columns_ = int(std::ceil(std::sqrt(double(object_count_))));
+}
+
+void TriangleScene::InitResources(const SceneContext& context) noexcept {
+  context_ = context;
+  VkDevice device = context_.device;
+  device_functions_ = context_.device_functions;
+
+  // Prepare the vertex and per-object data. The vertex data will never
+  // change so one buffer is sufficient regardless of the value of
+  // QVulkanWindow::CONCURRENT_FRAME_COUNT. The matrices are changing per
+  // frame however so active frames have to have a dedicated copy.
+
+  // Use just one memory allocation and one buffer. We will then specify the
+  // appropriate offsets in the VkDescriptorBufferInfo and as dynamic offsets.
+  // Have to watch out for
+  // VkPhysicalDeviceLimits::minUniformBufferOffsetAlignment and
+  // minStorageBufferOffsetAlignment, though.
+
+  // A single matrix (64 bytes) also fits into the spec mandated minimum push
+  // constant limit of 128 bytes, so DrawPath::kPushConstants does not touch
+  // the buffer at all. Which path is cheapest depends on the driver, see
+  // `VkTriangle --headless --draw-path all`.
+
+  const int concurrent_frame_count = context_.concurrent_frame_count;
+  Q_ASSERT(concurrent_frame_count <= kMaxConcurrentFrameCount);
+  const VkPhysicalDeviceLimits* device_limits = context_.limits;
+  const VkDeviceSize uniform_alignment =
+      device_limits->minUniformBufferOffsetAlignment;
+  const VkDeviceSize alignment = std::max(
+      uniform_alignment, device_limits->minStorageBufferOffsetAlignment);
+  qDebug("uniform buffer offset alignment is %u", (uint)uniform_alignment);
+
+  // Our internal layout is vertex, frame, frame, ... with each frame start
+  // offset aligned to alignment. Dynamic offsets inside a frame have to be
+  // multiples of the uniform alignment.
+  object_stride_ = Aligned(kUniformDataSize, uniform_alignment);
+  const VkDeviceSize kVertexAllocSize = Aligned(sizeof(vertex_data), alignment);
+  const VkDeviceSize kFrameAllocSize =
+      Aligned(object_count_ * object_stride_, alignment);
+  VkBufferCreateInfo buffer_info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = kVertexAllocSize + concurrent_frame_count * kFrameAllocSize,
+      .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+
+  VkResult err = device_functions_->vkCreateBuffer(device, &buffer_info,
+                                                   nullptr, &buffer_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create buffer: %d", err);
+  }
+
+  VkMemoryRequirements mem_req;
+  device_functions_->vkGetBufferMemoryRequirements(device, buffer_, &mem_req);
+
+  uint32_t memory_index = context_.host_visible_memory_index;
+  if (context_.preferred_memory_index >= 0) {
+    // The preferred type may come from a profile saved for another driver
+    // version, and a small BAR heap cannot take many objects.
+    const uint32_t preferred = uint32_t(context_.preferred_memory_index);
+    const VkPhysicalDeviceMemoryProperties& memory =
+        *context_.memory_properties;
+    if (preferred < memory.memoryTypeCount &&
+        ((mem_req.memoryTypeBits >> preferred) & 1) &&
+        mem_req.size <=
+            memory.memoryHeaps[memory.memoryTypes[preferred].heapIndex].size) {
+      memory_index = preferred;
+    } else {
+      qWarning("Memory type %u cannot hold the buffer, using type %u",
+               preferred, memory_index);
+    }
+  }
+  VkMemoryAllocateInfo mem_alloc_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                                      nullptr, mem_req.size, memory_index};
+
+  err = device_functions_->vkAllocateMemory(device, &mem_alloc_info, nullptr,
+                                            &device_memory_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to allocate memory: %d", err);
+  }
+
+  err =
+      device_functions_->vkBindBufferMemory(device, buffer_, device_memory_, 0);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to bind buffer memory: %d", err);
+  }
+
+  // With many objects, mapping once per frame is measurable, so the memory
+  // stays mapped until ReleaseResources().
+  err = device_functions_->vkMapMemory(device, device_memory_, 0, mem_req.size,
+                                       0, reinterpret_cast<void**>(&mapped_));
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to map memory: %d", err);
+  }
+  memcpy(mapped_, vertex_data, sizeof(vertex_data));
+  for (int i = 0; i < concurrent_frame_count; ++i) {
+    frame_offset_[i] = kVertexAllocSize + i * kFrameAllocSize;
+  }
+
+  // Set up descriptor sets and their layouts: a dynamic uniform buffer and a
+  // storage buffer per frame. Push constants need none.
+  VkDescriptorPoolSize desc_pool_sizes[] = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+       uint32_t(concurrent_frame_count)},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uint32_t(concurrent_frame_count)}};
+  VkDescriptorPoolCreateInfo desc_pool_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = uint32_t(2 * concurrent_frame_count),
+      .poolSizeCount = 2,
+      .pPoolSizes = desc_pool_sizes};
+  err = device_functions_->vkCreateDescriptorPool(device, &desc_pool_info,
+                                                  nullptr, &desc_pool_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create descriptor pool: %d", err);
+  }
+
+  const VkDescriptorType desc_types[] = {
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+  VkDescriptorSetLayout* desc_set_layouts[] = {&uniform_set_layout_,
+                                               &storage_set_layout_};
+  for (int i = 0; i < 2; ++i) {
+    VkDescriptorSetLayoutBinding layoutBinding = {
+        0,  // binding
+        desc_types[i], 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 1,
+        &layoutBinding};
+    err = device_functions_->vkCreateDescriptorSetLayout(
+        device, &descLayoutInfo, nullptr, desc_set_layouts[i]);
+    if (err != VK_SUCCESS) {
+      qFatal("Failed to create descriptor set layout: %d", err);
+    }
+  }
+
+  for (int i = 0; i < concurrent_frame_count; ++i) {
+    const VkDescriptorSetLayout set_layouts[] = {uniform_set_layout_,
+                                                 storage_set_layout_};
+    VkDescriptorSet sets[2];
+    VkDescriptorSetAllocateInfo desc_set_alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = desc_pool_,
+        .descriptorSetCount = 2,
+        .pSetLayouts = set_layouts};
+    err = device_functions_->vkAllocateDescriptorSets(
+        device, &desc_set_alloc_info, sets);
+    if (err != VK_SUCCESS) {
+      qFatal("Failed to allocate descriptor set: %d", err);
+    }
+    uniform_set_[i] = sets[0];
+    storage_set_[i] = sets[1];
+
+    // The uniform buffer covers one matrix, the dynamic offset picks which.
+    // The storage buffer covers all of them as an array.
+    const VkDescriptorBufferInfo uniform_info{.buffer = buffer_,
+                                              .offset = frame_offset_[i],
+                                              .range = kUniformDataSize};
+    const VkDescriptorBufferInfo storage_info{
+        .buffer = buffer_,
+        .offset = frame_offset_[i],
+        .range = VkDeviceSize(object_count_) * kUniformDataSize};
+    VkWriteDescriptorSet desc_writes[] = {
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = uniform_set_[i],
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+         .pBufferInfo = &uniform_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = storage_set_[i],
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo = &storage_info}};
+    device_functions_->vkUpdateDescriptorSets(device, 2, desc_writes, 0,
+                                              nullptr);
+  }
+
+  // Pipeline cache
+  VkPipelineCacheCreateInfo pipeline_cache_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  err = device_functions_->vkCreatePipelineCache(device, &pipeline_cache_info,
+                                                 nullptr, &pipeline_cache_);
+  if (err != VK_SUCCESS) {
+    qFatal("Failed to create pipeline cache: %d", err);
+  }
+
+  // Pipeline layouts, one per draw path
+  const VkPushConstantRange push_constant_range{
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+      .offset = 0,
+      .size = kUniformDataSize};
+  const VkPipelineLayoutCreateInfo pipeline_layout_infos[kDrawPathCount] = {
+      // DrawPath::kPushConstants
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant_range},
+      // DrawPath::kDynamicUniform
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+       .setLayoutCount = 1,
+       .pSetLayouts = &uniform_set_layout_},
+      // DrawPath::kStorageBuffer
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+       .setLayoutCount = 1,
+       .pSetLayouts = &storage_set_layout_}};
+  for (int i = 0; i < kDrawPathCount; ++i) {
+    err = device_functions_->vkCreatePipelineLayout(
+        device, &pipeline_layout_infos[i], nullptr, &pipeline_layouts_[i]);
+    if (err != VK_SUCCESS) {
+      qFatal("Failed to create pipeline layout: %d", err);
+    }
+  }
+
+  // Shaders, kept until ReleaseResources() since pipeline variants keep
+  // being compiled from them in the background.
+  const QString vert_shader_names[kDrawPathCount] = {
+      QStringLiteral(":/color_push_vert.spv"),
+      QStringLiteral(":/color_vert.spv"),
+      QStringLiteral(":/color_ssbo_vert.spv")};
+  for (int i = 0; i < kDrawPathCount; ++i) {
+    vert_shader_modules_[i] = CreateShader(vert_shader_names[i]);
+  }
+  frag_shader_module_ = CreateShader(QStringLiteral(":/color_frag.spv"));
+
+  // Only the variant drawn first is compiled here, see PipelineLibrary.
+  key_.sample_count = context_.sample_count;
+  PipelineLibrary::Context library_context{
+      .device = device,
+      .device_functions = device_functions_,
+      .pipeline_cache = pipeline_cache_,
+      .render_pass = context_.render_pass,
+      .frag_shader = frag_shader_module_};
+  std::copy(std::begin(pipeline_layouts_), std::end(pipeline_layouts_),
+            library_context.pipeline_layouts);
+  std::copy(std::begin(vert_shader_modules_), std::end(vert_shader_modules_),
+            library_context.vert_shaders);
+  pipelines_.Init(library_context, key_);
+}
+
+void TriangleScene::SetVariant(BlendMode blend, quint32 features) noexcept {
+  key_.blend = blend;
+  key_.features = features;
+}
+
+void TriangleScene::SetDrawPath(DrawPath draw_path) noexcept {
+  key_.draw_path = draw_path;
+}
+
+void TriangleScene::PrewarmVariants() noexcept {
+  QList<PipelineKey> keys;
+  for (int path = 0; path < kDrawPathCount; ++path) {
+    for (BlendMode blend :
+         {BlendMode::kOpaque, BlendMode::kAlpha, BlendMode::kAdditive}) {
+      for (quint32 features = 0; features <= kShaderFeatureAll; ++features) {
+        keys.append(PipelineKey{.draw_path = DrawPath(path),
+                     .sample_count = context_.sample_count,
+                     .blend = blend,
+                     .features = features});
+      }
+    }
+  }
+  pipelines_.Prewarm(keys);
+}
+
+void TriangleScene::Resize(const QSize& size,
+                           const QMatrix4x4& clip_correction) noexcept {
+  size_ = size;
+
+  // Projection matrix
+  projection_ = clip_correction;  // adjust for Vulkan-OpenGL clip space
+                                  // differences
+  projection_.perspective(45.0f, size.width() / (float)size.height(), 0.01f,
+                          100.0f);
+  projection_.translate(0, 0, -4);
+}
+
+void TriangleScene::ReleaseResources() noexcept {
+  VkDevice dev = context_.device;
+
+  pipelines_.Release();
+
+  for (VkShaderModule& shader_module : vert_shader_modules_) {
+    if (shader_module) {
+      device_functions_->vkDestroyShaderModule(dev, shader_module, nullptr);
+      shader_module = VK_NULL_HANDLE;
+    }
+  }
+
+  if (frag_shader_module_) {
+    device_functions_->vkDestroyShaderModule(dev, frag_shader_module_,
+                                             nullptr);
+    frag_shader_module_ = VK_NULL_HANDLE;
+  }
+
+  for (VkPipelineLayout& pipeline_layout : pipeline_layouts_) {
+    if (pipeline_layout) {
+      device_functions_->vkDestroyPipelineLayout(dev, pipeline_layout,
+                                                 nullptr);
+      pipeline_layout = VK_NULL_HANDLE;
+    }
+  }
+
+  if (pipeline_cache_) {
+    device_functions_->vkDestroyPipelineCache(dev, pipeline_cache_, nullptr);
+    pipeline_cache_ = VK_NULL_HANDLE;
+  }
+
+  if (uniform_set_layout_) {
+    device_functions_->vkDestroyDescriptorSetLayout(dev, uniform_set_layout_,
+                                                    nullptr);
+    uniform_set_layout_ = VK_NULL_HANDLE;
+  }
+
+  if (storage_set_layout_) {
+    device_functions_->vkDestroyDescriptorSetLayout(dev, storage_set_layout_,
+                                                    nullptr);
+    storage_set_layout_ = VK_NULL_HANDLE;
+  }
+
+  if (desc_pool_) {
+    device_functions_->vkDestroyDescriptorPool(dev, desc_pool_, nullptr);
+    desc_pool_ = VK_NULL_HANDLE;
+  }
+
+  if (buffer_) {
+    device_functions_->vkDestroyBuffer(dev, buffer_, nullptr);
+    buffer_ = VK_NULL_HANDLE;
+  }
+
+  if (device_memory_) {
+    device_functions_->vkUnmapMemory(dev, device_memory_);
+    mapped_ = nullptr;
+    device_functions_->vkFreeMemory(dev, device_memory_, nullptr);
+    device_memory_ = VK_NULL_HANDLE;
+  }
+}
+
+bool TriangleScene::Record(VkCommandBuffer cb,
+                           VkFramebuffer framebuffer,
+                           int frame,
+                           VkDescriptorSet object_set) noexcept {
+  VkClearColorValue clear_color{.float32{0.0f, 0.25f, 0.0f, 1.0f}};
+  VkClearDepthStencilValue clear_ds{.depth = 1.0f, .stencil = 0};
+  VkClearValue clear_values[3]{{.color = clear_color},
+                               {.depthStencil = clear_ds},
+                               {.color = clear_color}};
+
+  const QSize sz = size_;
+  VkRenderPassBeginInfo render_pass_begin_info{
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+      .renderPass = context_.render_pass,
+      .framebuffer = framebuffer,
+      .renderArea = {.extent = {.width = uint32_t(sz.width()),
+                                .height = uint32_t(sz.height())}},
+      .clearValueCount =
+          context_.sample_count > VK_SAMPLE_COUNT_1_BIT ? 3U : 2U,
+      .pClearValues = clear_values};
+  device_functions_->vkCmdBeginRenderPass(cb, &render_pass_begin_info,
+                                          VK_SUBPASS_CONTENTS_INLINE);
+
+  PipelineKey key = key_;
+  if (object_set) {
+    key.draw_path = DrawPath::kStorageBuffer;
+  }
+  const DrawPath draw_path = key.draw_path;
+  const VkPipelineLayout pipeline_layout = pipeline_layouts_[int(draw_path)];
+  bool ready{};
+  VkPipeline pipeline = pipelines_.Get(key, &ready);
+  device_functions_->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                       pipeline);
+  VkDeviceSize vertex_buffers_offset = 0;
+  device_functions_->vkCmdBindVertexBuffers(cb, 0, 1, &buffer_,
+                                            &vertex_buffers_offset);
+
+  VkViewport viewport{.x = 0,
+                      .y = 0,
+                      .width = float(sz.width()),
+                      .height = float(sz.height()),
+                      .minDepth = 0,
+                      .maxDepth = 1};
+  device_functions_->vkCmdSetViewport(cb, 0, 1, &viewport);
+
+  VkRect2D scissor{.offset{.x = 0, .y = 0},
+                   .extent = render_pass_begin_info.renderArea.extent};
+  device_functions_->vkCmdSetScissor(cb, 0, 1, &scissor);
+
+  // One draw per object in every path, so the paths differ only in how the
+  // matrix gets there.
+  quint8* frame_data = mapped_ + frame_offset_[frame];
+  switch (draw_path) {
+    case DrawPath::kPushConstants:
+      for (int i = 0; i < object_count_; ++i) {
+        const QMatrix4x4 m = ObjectMatrix(i);
+        device_functions_->vkCmdPushConstants(cb, pipeline_layout,
+                                              VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                              kUniformDataSize, m.constData());
+        device_functions_->vkCmdDraw(cb, 3, 1, 0, 0);
+      }
+      break;
+    case DrawPath::kDynamicUniform:
+      for (int i = 0; i < object_count_; ++i) {
+        const QMatrix4x4 m = ObjectMatrix(i);
+        const VkDeviceSize offset = i * object_stride_;
+        memcpy(frame_data + offset, m.constData(), kUniformDataSize);
+        const uint32_t dynamic_offset = uint32_t(offset);
+        device_functions_->vkCmdBindDescriptorSets(
+            cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
+            &uniform_set_[frame], 1, &dynamic_offset);
+        device_functions_->vkCmdDraw(cb, 3, 1, 0, 0);
+      }
+      break;
+    case DrawPath::kStorageBuffer:
+      device_functions_->vkCmdBindDescriptorSets(
+          cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
+          object_set ? &object_set : &storage_set_[frame], 0, nullptr);
+      for (int i = 0; i < object_count_; ++i) {
+        if (!object_set) {
+          const QMatrix4x4 m = ObjectMatrix(i);
+          memcpy(frame_data + i * kUniformDataSize, m.constData(),
+                 kUniformDataSize);
+        }
+        // The shader indexes the matrices with gl_InstanceIndex, which
+        // starts at firstInstance.
+        device_functions_->vkCmdDraw(cb, 3, 1, 0, uint32_t(i));
+      }
+      break;
+  }
+
+  // Not exactly a real animation system, just advance on every frame for now.
+  rotation_ += 1.0f;
+
+  device_functions_->vkCmdEndRenderPass(cb);
+  return ready;
+}
+
+QMatrix4x4 TriangleScene::ObjectMatrix(int index) const {
+  QMatrix4x4 m = projection_;
+  if (object_count_ > 1) {
+    // Lay the objects out on a grid filling [-1, 1] x [-1, 1].
+    const float cell = 2.0f / grid_columns_;
+    m.translate(-1.0f + cell * (index % grid_columns_ + 0.5f),
+                -1.0f + cell * (index / grid_columns_ + 0.5f), 0);
+    m.scale(cell);
+  }
+  m.rotate(rotation_ + index * 7.0f, 0, 1, 0);
+  return m;
+}
+
+VkShaderModule TriangleScene::CreateShader(const QString& name) {
+  QFile file(name);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning("Failed to read shader %s", qPrintable(name));
+    return VK_NULL_HANDLE;
+  }
+  QByteArray blob = file.readAll();
+  file.close();
+
+  VkShaderModuleCreateInfo shader_info{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = static_cast<size_t>(blob.size()),
+      .pCode = reinterpret_cast<const uint32_t*>(blob.constData())};
+  VkShaderModule shader_module;
+  VkResult err = device_functions_->vkCreateShaderModule(
+      context_.device, &shader_info, nullptr, &shader_module);
+  if (err != VK_SUCCESS) {
+    qWarning("Failed to create shader module: %d", err);
+    return VK_NULL_HANDLE;
+  }
+
+  return shader_module;
+}
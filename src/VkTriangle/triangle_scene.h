@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QtCore/QSize>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanWindow>
+
+#include "pipeline_library.h"
+
+// Everything the scene needs from whoever owns the device and the render
+// target. Filled in by TriangleRenderer from QVulkanWindow, or by
+// HeadlessBenchmark from its own device and offscreen images.
+struct SceneContext {
+  VkDevice device{VK_NULL_HANDLE};
+  QVulkanDeviceFunctions* device_functions{};
+  const VkPhysicalDeviceLimits* limits{};
+  const VkPhysicalDeviceMemoryProperties* memory_properties{};
+  // Memory type for the buffer, -1 for none. Only used if the buffer may be
+  // bound to it and its heap can hold the buffer, otherwise the buffer goes
+  // to host_visible_memory_index.
+  int preferred_memory_index{-1};
+  uint32_t host_visible_memory_index{};
+  VkRenderPass render_pass{VK_NULL_HANDLE};
+  VkSampleCountFlagBits sample_count{VK_SAMPLE_COUNT_1_BIT};
+  int concurrent_frame_count{1};
+};
+
+// The triangles themselves: buffers, descriptors, pipelines and command
+// recording. Knows nothing about swapchains, so the same code runs in a window
+// and headless.
+class TriangleScene {
+ public:
+  // Headless runs may keep more frames in flight than QVulkanWindow allows.
+  static constexpr int kMaxConcurrentFrameCount{8};
+  static_assert(kMaxConcurrentFrameCount >=
+                QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT);
+
+  // Number of triangles drawn per frame, each with its own matrix. Takes
+  // effect at the next InitResources().
+  void SetObjectCount(int count) noexcept;
+  int object_count() const noexcept { return object_count_; }
+
+  void InitResources(const SceneContext& context) noexcept;
+  void ReleaseResources() noexcept;
+
+  void Resize(const QSize& size, const QMatrix4x4& clip_correction) noexcept;
+
+  // Selects the pipeline variant drawn from the next frame on.
+  void SetVariant(BlendMode blend, quint32 features) noexcept;
+  void SetDrawPath(DrawPath draw_path) noexcept;
+  DrawPath draw_path() const noexcept { return key_.draw_path; }
+  // Starts compiling every variant for the current sample count in the
+  // background.
+  void PrewarmVariants() noexcept;
+  PipelineLibrary* pipelines() noexcept { return &pipelines_; }
+
+  // Updates the uniform buffer of `frame` and records one complete render
+  // pass into `cb`. Returns false if the selected variant is still compiling
+  // and the fallback pipeline was drawn instead. With an `object_set` (see
+  // storage_set_layout()) the matrices were computed on the GPU already: the
+  // SSBO path draws from that set and nothing is written on the CPU.
+  bool Record(VkCommandBuffer cb,
+              VkFramebuffer framebuffer,
+              int frame,
+              VkDescriptorSet object_set = VK_NULL_HANDLE) noexcept;
+
+  // What ObjectMatrix() works from, for computing the matrices elsewhere.
+  const QMatrix4x4& projection() const noexcept { return projection_; }
+  float rotation() const noexcept { return rotation_; }
+  int grid_columns() const noexcept { return grid_columns_; }
+  VkDescriptorSetLayout storage_set_layout() const noexcept {
+    return storage_set_layout_;
+  }
+
+ private:
+  VkShaderModule CreateShader(const QString& name);
+  QMatrix4x4 ObjectMatrix(int index) const;
+
+ private:
+  SceneContext context_;
+  QVulkanDeviceFunctions* device_functions_{};
+  QSize size_;
+
+  int object_count_{1};
+  int grid_columns_{1};
+
+  VkDeviceMemory device_memory_{VK_NULL_HANDLE};
+  VkBuffer buffer_{VK_NULL_HANDLE};
+  quint8* mapped_{};  // persistently mapped, host coherent
+  // Per frame in flight: object_count_ matrices, object_stride_ apart for the
+  // dynamic UBO path and tightly packed for the SSBO path.
+  VkDeviceSize frame_offset_[kMaxConcurrentFrameCount]{};
+  VkDeviceSize object_stride_{};
+
+  VkDescriptorPool desc_pool_{VK_NULL_HANDLE};
+  VkDescriptorSetLayout uniform_set_layout_{VK_NULL_HANDLE};
+  VkDescriptorSetLayout storage_set_layout_{VK_NULL_HANDLE};
+  VkDescriptorSet uniform_set_[kMaxConcurrentFrameCount]{};
+  VkDescriptorSet storage_set_[kMaxConcurrentFrameCount]{};
+
+  VkPipelineCache pipeline_cache_{VK_NULL_HANDLE};
+  VkPipelineLayout pipeline_layouts_[kDrawPathCount]{};
+  VkShaderModule vert_shader_modules_[kDrawPathCount]{};
+  VkShaderModule frag_shader_module_{VK_NULL_HANDLE};
+  PipelineLibrary pipelines_;
+  PipelineKey key_;
+
+  QMatrix4x4 projection_;
+  float rotation_{0.0f};
+};
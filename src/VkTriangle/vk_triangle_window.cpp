@@ -1,5 +1,36 @@
 ﻿#include "vk_triangle_window.h"
 
+#include <QtGui/QKeyEvent>
+#include <QtGui/QMouseEvent>
+
 QVulkanWindowRenderer* VkTriangleWindow::createRenderer() noexcept {
-  return new TriangleRenderer(this, true);  // try MSAA, when available
+  renderer_ = new TriangleRenderer(this, true);  // try MSAA, when available
+  renderer_->SetObjectCount(object_count_);
+  renderer_->SetFramePacing(pacing_);
+  renderer_->SetSimulation(simulation_);
+  return renderer_;
+}
+
+void VkTriangleWindow::keyPressEvent(QKeyEvent* event) {
+  if (renderer_) {
+    renderer_->OnInput();
+  }
+  // B: next blend mode, F: next shader feature combination, D: next draw
+  // path.
+  if (renderer_ && event->key() == Qt::Key_B) {
+    renderer_->NextBlendMode();
+  } else if (renderer_ && event->key() == Qt::Key_F) {
+    renderer_->NextFeatures();
+  } else if (renderer_ && event->key() == Qt::Key_D) {
+    renderer_->NextDrawPath();
+  } else {
+    QVulkanWindow::keyPressEvent(event);
+  }
+}
+
+void VkTriangleWindow::mousePressEvent(QMouseEvent* event) {
+  if (renderer_) {
+    renderer_->OnInput();
+  }
+  QVulkanWindow::mousePressEvent(event);
 }
@@ -4,5 +4,22 @@
 
 class VkTriangleWindow : public QVulkanWindow {
  public:
+  // Triangles drawn per frame, see TriangleScene::SetObjectCount().
+  void SetObjectCount(int count) noexcept { object_count_ = count; }
+  void SetFramePacing(const FramePacer::Options& options) noexcept {
+    pacing_ = options;
+  }
+  void SetSimulation(SimulationMode mode) noexcept { simulation_ = mode; }
+
   QVulkanWindowRenderer* createRenderer() noexcept override;
+
+ protected:
+  void keyPressEvent(QKeyEvent* event) override;
+  void mousePressEvent(QMouseEvent* event) override;
+
+ private:
+  TriangleRenderer* renderer_{};
+  int object_count_{1};
+  FramePacer::Options pacing_;
+  SimulationMode simulation_{SimulationMode::kOff};
 };
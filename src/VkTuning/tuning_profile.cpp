@@ -0,0 +1,263 @@
+#include "tuning_profile.h"
+
+#include <bit>
+#include <vector>
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtGui/QVulkanFunctions>
+
+namespace {
+// Highest scoring memory type that has all of `required`: each `preferred`
+// flag counts two, each `avoided` flag costs one. -1 if none qualifies.
+int PickMemoryType(const VkPhysicalDeviceMemoryProperties& memory,
+                   VkMemoryPropertyFlags required,
+                   VkMemoryPropertyFlags preferred,
+                   VkMemoryPropertyFlags avoided) {
+  int best = -1;
+  int best_score = 0;
+  for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+    const VkMemoryPropertyFlags flags = memory.memoryTypes[i].propertyFlags;
+    if ((flags & required) != required ||
+        (flags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT |
+                  VK_MEMORY_PROPERTY_PROTECTED_BIT))) {
+      continue;
+    }
+    const int score = 2 * std::popcount(flags & preferred) -
+                      std::popcount(flags & avoided);
+    if (best < 0 || score > best_score) {
+      best = int(i);
+      best_score = score;
+    }
+  }
+  return best;
+}
+}  // namespace
+
+TuningProfile TuningProfile::Probe(QVulkanInstance* instance,
+                                   VkPhysicalDevice physical_device) {
+  QVulkanFunctions* f = instance->functions();
+  VkPhysicalDeviceProperties properties{};
+  f->vkGetPhysicalDeviceProperties(physical_device, &properties);
+  VkPhysicalDeviceMemoryProperties memory{};
+  f->vkGetPhysicalDeviceMemoryProperties(physical_device, &memory);
+
+  TuningProfile profile;
+  profile.vendor_id = properties.vendorID;
+  profile.device_id = properties.deviceID;
+  profile.driver_version = properties.driverVersion;
+  profile.pipeline_cache_uuid = QByteArray(
+      reinterpret_cast<const char*>(properties.pipelineCacheUUID),
+      VK_UUID_SIZE);
+
+  uint32_t family_count{};
+  f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                              nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  f->vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                              families.data());
+  for (uint32_t i = 0; i < family_count; ++i) {
+    const VkQueueFlags flags = families[i].queueFlags;
+    profile.queue_families.append({.flags = flags,
+                                   .queue_count = families[i].queueCount,
+                                   .timestamp_valid_bits =
+                                       families[i].timestampValidBits});
+    if (profile.graphics_family < 0 && (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      profile.graphics_family = int(i);
+    }
+    if (profile.compute_family < 0 && (flags & VK_QUEUE_COMPUTE_BIT) &&
+        !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+      profile.compute_family = int(i);
+    }
+    if (profile.transfer_family < 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      profile.transfer_family = int(i);
+    }
+  }
+
+  constexpr VkMemoryPropertyFlags kDeviceLocal =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  constexpr VkMemoryPropertyFlags kHostVisible =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  constexpr VkMemoryPropertyFlags kHostCoherent =
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  constexpr VkMemoryPropertyFlags kHostCached =
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  profile.device_local_type =
+      PickMemoryType(memory, kDeviceLocal, 0, kHostVisible);
+  // Leave the (often small) device local host visible window to dynamic data.
+  profile.upload_type = PickMemoryType(memory, kHostVisible | kHostCoherent, 0,
+                                       kDeviceLocal | kHostCached);
+  profile.dynamic_type = PickMemoryType(memory, kHostVisible | kHostCoherent,
+                                        kDeviceLocal, kHostCached);
+  profile.readback_type =
+      PickMemoryType(memory, kHostVisible, kHostCached | kHostCoherent, 0);
+
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+  profile.min_uniform_buffer_offset_alignment =
+      limits.minUniformBufferOffsetAlignment;
+  profile.min_storage_buffer_offset_alignment =
+      limits.minStorageBufferOffsetAlignment;
+  profile.optimal_buffer_copy_offset_alignment =
+      limits.optimalBufferCopyOffsetAlignment;
+  profile.non_coherent_atom_size = limits.nonCoherentAtomSize;
+  profile.max_push_constants_size = limits.maxPushConstantsSize;
+  profile.timestamp_period = limits.timestampPeriod;
+  profile.sample_counts = limits.framebufferColorSampleCounts &
+                          limits.framebufferDepthSampleCounts;
+  return profile;
+}
+
+TuningProfile TuningProfile::LoadOrProbe(QVulkanInstance* instance,
+                                         VkPhysicalDevice physical_device,
+                                         bool* loaded) {
+  VkPhysicalDeviceProperties properties{};
+  instance->functions()->vkGetPhysicalDeviceProperties(physical_device,
+                                                       &properties);
+  const QString path = PathFor(properties);
+
+  TuningProfile profile;
+  if (Load(path, &profile) && profile.Matches(properties)) {
+    if (loaded) {
+      *loaded = true;
+    }
+    return profile;
+  }
+
+  // Missing, or the driver was updated since: the old measurements are void.
+  qInfo("Tuning profile %s is missing or stale, probing again; run "
+        "VkInfo --tuning-profile to measure upload sizes",
+        qPrintable(path));
+  profile = Probe(instance, physical_device);
+  profile.Save(path);
+  if (loaded) {
+    *loaded = false;
+  }
+  return profile;
+}
+
+QString TuningProfile::PathFor(const VkPhysicalDeviceProperties& properties) {
+  return QStandardPaths::writableLocation(
+             QStandardPaths::GenericCacheLocation) +
+         QStringLiteral("/VkTuning/%1-%2.json")
+             .arg(properties.vendorID, 4, 16, QLatin1Char('0'))
+             .arg(properties.deviceID, 4, 16, QLatin1Char('0'));
+}
+
+bool TuningProfile::Matches(
+    const VkPhysicalDeviceProperties& properties) const {
+  return vendor_id == properties.vendorID &&
+         device_id == properties.deviceID &&
+         driver_version == properties.driverVersion &&
+         pipeline_cache_uuid ==
+             QByteArray::fromRawData(
+                 reinterpret_cast<const char*>(properties.pipelineCacheUUID),
+                 VK_UUID_SIZE);
+}
+
+QJsonObject TuningProfile::ToJson() const {
+  QJsonArray families;
+  for (const QueueFamily& family : queue_families) {
+    families.append(QJsonObject{
+        {"flags", int(family.flags)},
+        {"queue_count", int(family.queue_count)},
+        {"timestamp_valid_bits", int(family.timestamp_valid_bits)}});
+  }
+  return {
+      {"version", kVersion},
+      {"vendor_id", double(vendor_id)},
+      {"device_id", double(device_id)},
+      {"driver_version", double(driver_version)},
+      {"pipeline_cache_uuid", QString::fromLatin1(pipeline_cache_uuid.toHex())},
+      {"queue_families", families},
+      {"graphics_family", graphics_family},
+      {"compute_family", compute_family},
+      {"transfer_family", transfer_family},
+      {"device_local_type", device_local_type},
+      {"upload_type", upload_type},
+      {"dynamic_type", dynamic_type},
+      {"readback_type", readback_type},
+      {"min_uniform_buffer_offset_alignment",
+       double(min_uniform_buffer_offset_alignment)},
+      {"min_storage_buffer_offset_alignment",
+       double(min_storage_buffer_offset_alignment)},
+      {"optimal_buffer_copy_offset_alignment",
+       double(optimal_buffer_copy_offset_alignment)},
+      {"non_coherent_atom_size", double(non_coherent_atom_size)},
+      {"max_push_constants_size", int(max_push_constants_size)},
+      {"timestamp_period", timestamp_period},
+      {"sample_counts", int(sample_counts)},
+      {"upload_chunk_size", double(upload_chunk_size)}};
+}
+
+bool TuningProfile::FromJson(const QJsonObject& json, TuningProfile* profile) {
+  if (json["version"].toInt() != kVersion) {
+    return false;
+  }
+  TuningProfile p;
+  p.vendor_id = uint32_t(json["vendor_id"].toDouble());
+  p.device_id = uint32_t(json["device_id"].toDouble());
+  p.driver_version = uint32_t(json["driver_version"].toDouble());
+  p.pipeline_cache_uuid =
+      QByteArray::fromHex(json["pipeline_cache_uuid"].toString().toLatin1());
+  for (const QJsonValue& value : json["queue_families"].toArray()) {
+    const QJsonObject family = value.toObject();
+    p.queue_families.append(
+        {.flags = VkQueueFlags(family["flags"].toInt()),
+         .queue_count = uint32_t(family["queue_count"].toInt()),
+         .timestamp_valid_bits =
+             uint32_t(family["timestamp_valid_bits"].toInt())});
+  }
+  p.graphics_family = json["graphics_family"].toInt(-1);
+  p.compute_family = json["compute_family"].toInt(-1);
+  p.transfer_family = json["transfer_family"].toInt(-1);
+  p.device_local_type = json["device_local_type"].toInt(-1);
+  p.upload_type = json["upload_type"].toInt(-1);
+  p.dynamic_type = json["dynamic_type"].toInt(-1);
+  p.readback_type = json["readback_type"].toInt(-1);
+  p.min_uniform_buffer_offset_alignment =
+      VkDeviceSize(json["min_uniform_buffer_offset_alignment"].toDouble());
+  p.min_storage_buffer_offset_alignment =
+      VkDeviceSize(json["min_storage_buffer_offset_alignment"].toDouble());
+  p.optimal_buffer_copy_offset_alignment =
+      VkDeviceSize(json["optimal_buffer_copy_offset_alignment"].toDouble());
+  p.non_coherent_atom_size =
+      VkDeviceSize(json["non_coherent_atom_size"].toDouble());
+  p.max_push_constants_size = uint32_t(json["max_push_constants_size"].toInt());
+  p.timestamp_period = float(json["timestamp_period"].toDouble());
+  p.sample_counts = VkSampleCountFlags(json["sample_counts"].toInt());
+  p.upload_chunk_size = VkDeviceSize(json["upload_chunk_size"].toDouble());
+  *profile = p;
+  return true;
+}
+
+bool TuningProfile::Save(const QString& path) const {
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  // VkInfo and the renderers share the file; replaced in one rename, so a
+  // racing or interrupted writer never leaves half a profile behind.
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning("Failed to write %s", qPrintable(path));
+    return false;
+  }
+  file.write(QJsonDocument(ToJson()).toJson());
+  if (!file.commit()) {
+    qWarning("Failed to write %s", qPrintable(path));
+    return false;
+  }
+  return true;
+}
+
+bool TuningProfile::Load(const QString& path, TuningProfile* profile) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+  return document.isObject() && FromJson(document.object(), profile);
+}
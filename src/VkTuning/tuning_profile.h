@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtGui/QVulkanInstance>
+
+// What a renderer wants to know about a device before creating anything:
+// queue families, the best memory type per usage, alignment limits, sample
+// counts and the measured upload chunk size. VkInfo --tuning-profile probes
+// and measures it once per machine; renderers load the cached JSON instead
+// of probing again. A profile is only valid for the exact driver it was
+// written for, see Matches().
+struct TuningProfile {
+  struct QueueFamily {
+    VkQueueFlags flags{};
+    uint32_t queue_count{};
+    uint32_t timestamp_valid_bits{};
+  };
+
+  // Bumped when fields change meaning; older files are probed again.
+  static constexpr int kVersion{2};
+  // Used while no upload chunk size was measured.
+  static constexpr VkDeviceSize kDefaultUploadChunkSize{1 << 20};
+
+  // Key.
+  uint32_t vendor_id{};
+  uint32_t device_id{};
+  uint32_t driver_version{};
+  QByteArray pipeline_cache_uuid;  // VK_UUID_SIZE bytes
+
+  QList<QueueFamily> queue_families;
+  int graphics_family{-1};
+  int compute_family{-1};   // compute without graphics, for async compute
+  int transfer_family{-1};  // transfer only, usually a DMA engine
+
+  // Memory type indices, -1 if the device has none that fits.
+  int device_local_type{-1};  // GPU only
+  int upload_type{-1};        // staging: host visible and coherent
+  int dynamic_type{-1};       // written by the CPU every frame, read by the GPU
+  int readback_type{-1};      // host cached where possible
+
+  VkDeviceSize min_uniform_buffer_offset_alignment{};
+  VkDeviceSize min_storage_buffer_offset_alignment{};
+  VkDeviceSize optimal_buffer_copy_offset_alignment{};
+  VkDeviceSize non_coherent_atom_size{};
+  uint32_t max_push_constants_size{};
+  float timestamp_period{};
+  VkSampleCountFlags sample_counts{};  // usable for color and depth
+
+  VkDeviceSize upload_chunk_size{};  // 0: not measured
+
+  // Everything but the measured values, from the physical device.
+  static TuningProfile Probe(QVulkanInstance* instance,
+                             VkPhysicalDevice physical_device);
+  // Loads the cached profile of `physical_device`. When there is none, or it
+  // was written for another driver, probes again and rewrites the cache.
+  static TuningProfile LoadOrProbe(QVulkanInstance* instance,
+                                   VkPhysicalDevice physical_device,
+                                   bool* loaded = nullptr);
+
+  // Where the profile of a device is cached, shared by all applications.
+  static QString PathFor(const VkPhysicalDeviceProperties& properties);
+
+  bool Matches(const VkPhysicalDeviceProperties& properties) const;
+  VkDeviceSize upload_chunk_size_or_default() const {
+    return upload_chunk_size ? upload_chunk_size : kDefaultUploadChunkSize;
+  }
+
+  QJsonObject ToJson() const;
+  static bool FromJson(const QJsonObject& json, TuningProfile* profile);
+  bool Save(const QString& path) const;
+  static bool Load(const QString& path, TuningProfile* profile);
+};